@@ -0,0 +1,60 @@
+// measures rendering cost per voice of every interpolation mode
+// a fixed number of sustained looped voices is rendered and discarded, like --sink null of primesynth
+#include "synthesizer.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace primesynth;
+
+int main(int argc, char** argv) {
+    static constexpr double SAMPLE_RATE = 44100.0;
+    static constexpr std::size_t BLOCK_SIZE = 256;
+    static constexpr std::uint32_t NUM_CHANNELS = 8;
+
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " soundfont [voices = 64] [seconds = 10]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::uint32_t numVoices = argc > 2 ? std::stoul(argv[2]) : 64;
+    const double duration = argc > 3 ? std::stod(argv[3]) : 10.0;
+    const auto numFrames = static_cast<std::size_t>(duration * SAMPLE_RATE);
+
+    static const std::pair<interp::Mode, const char*> MODES[] = {{interp::Mode::None, "none"},
+                                                                 {interp::Mode::Linear, "linear"},
+                                                                 {interp::Mode::Cubic, "cubic"},
+                                                                 {interp::Mode::Sinc, "sinc"}};
+    try {
+        std::printf("%u voices, %g s at %g Hz\n", numVoices, duration, SAMPLE_RATE);
+        std::vector<float> buffer(2 * BLOCK_SIZE);
+        for (const auto& mode : MODES) {
+            Synthesizer synth(SAMPLE_RATE, NUM_CHANNELS);
+            synth.loadSoundFont(argv[1]);
+            synth.setPolyphony(numVoices);
+            synth.setInterpolation(mode.first);
+            // distinct keys spread over channels, so that no voice is replaced by another
+            for (std::uint32_t i = 0; i < numVoices; ++i) {
+                synth.processShortMessage(0x90 | i % NUM_CHANNELS | (20 + i / NUM_CHANNELS) % 128 << 8 | 100 << 16);
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            for (std::size_t frame = 0; frame < numFrames; frame += BLOCK_SIZE) {
+                synth.renderBlock(buffer.data(), BLOCK_SIZE);
+            }
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::printf("%-7s %6.1f ns/frame per voice  %7.1fx realtime\n", mode.second,
+                        elapsed * 1e9 / numVoices / numFrames, duration / elapsed);
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
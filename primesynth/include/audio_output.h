@@ -7,15 +7,19 @@
 namespace primesynth {
 class AudioOutput {
 public:
+    // in pull mode, audio callback renders exactly as many frames as the device asks for,
+    // so that latency is only the device period
+    // otherwise a thread renders ahead into a buffer of bufferSize samples, which tolerates slow rendering
     AudioOutput(Synthesizer& synth, std::size_t bufferSize, int deviceID = getDefaultDeviceID(),
-                double sampleRate = getDefaultSampleRate());
+                double sampleRate = getDefaultSampleRate(), bool pull = false);
     ~AudioOutput();
 
     static int getDefaultDeviceID();
     static double getDefaultSampleRate();
 
 private:
-    RingBuffer buffer_;
+    // interleaved stereo samples
+    RingBuffer<float> buffer_;
     PaStream* stream_;
     std::thread renderingThread;
     std::atomic_bool running_;
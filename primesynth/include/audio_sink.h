@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace primesynth {
+enum class SampleFormat { Int16, Int24, Float32 };
+
+std::size_t getBytesPerSample(SampleFormat format);
+// converts samples in [-1, 1] into little-endian bytes of given format
+void convertSamples(const float* samples, std::size_t numSamples, SampleFormat format, char* out);
+
+// destination of rendered audio, which is written block by block
+// implementations process whole blocks so that there is no virtual call per sample
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    // buffer contains interleaved stereo frames in [-1, 1]
+    virtual void write(const float* buffer, std::size_t numFrames) = 0;
+    // flushes written audio, no more writes are allowed after this
+    virtual void close() {}
+};
+
+// discards audio, for benchmarking rendering
+class NullSink : public AudioSink {
+public:
+    void write(const float*, std::size_t) override {}
+};
+
+// writes headerless interleaved stereo samples, for piping into encoders
+class RawSink : public AudioSink {
+public:
+    // "-" means stdout, other filenames may also be FIFOs
+    RawSink(const std::string& filename, SampleFormat format);
+    ~RawSink() override;
+
+    RawSink(const RawSink&) = delete;
+    RawSink& operator=(const RawSink&) = delete;
+
+    void write(const float* buffer, std::size_t numFrames) override;
+    void close() override;
+
+private:
+    std::FILE* file_;
+    const bool ownsFile_;
+    const SampleFormat format_;
+    std::vector<char> converted_;
+};
+}
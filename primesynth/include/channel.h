@@ -1,15 +1,28 @@
 #pragma once
 #include "midi.h"
-#include "voice.h"
-#include <mutex>
+#include "voice_pool.h"
+#include <bitset>
+#include <tuple>
 
 namespace primesynth {
+// how preferable the best victim of a channel is, compared across channels
+struct VictimRank {
+    int priority;
+    int group;
+    unsigned int age;
+
+    bool operator<(const VictimRank& b) const {
+        return std::tie(priority, group, age) < std::tie(b.priority, b.group, b.age);
+    }
+};
+
 class Channel {
 public:
     explicit Channel(double outputRate);
 
     midi::Bank getBank() const;
     bool hasPreset() const;
+    std::size_t getNumVoices() const;
 
     void noteOff(std::uint8_t key);
     void noteOn(std::uint8_t key, std::uint8_t velocity);
@@ -18,12 +31,22 @@ public:
     void channelPressure(std::uint8_t value);
     void pitchBend(std::uint16_t value);
     void setPreset(const std::shared_ptr<const Preset>& preset);
-    StereoValue render();
+    void setInterpolation(interp::Mode interpolation);
+    // stops all voices
+    void setCalcInterval(unsigned int interval);
+    // voices on channels with lower priority are stolen first under StealingPolicy::LowestPriority
+    void setPriority(int priority);
+    // returns false if there is no voice to steal
+    bool findVictim(StealingPolicy policy, VictimRank& rank);
+    bool stealVoice(StealingPolicy policy);
+    void render(float* left, float* right, std::size_t numFrames);
 
 private:
     enum class DataEntryMode { RPN, NRPN };
 
     const double outputRate_;
+    interp::Mode interpolation_;
+    int priority_;
     std::shared_ptr<const Preset> preset_;
     std::array<std::uint8_t, midi::NUM_CONTROLLERS> controllers_;
     std::array<std::uint16_t, static_cast<std::size_t>(midi::RPN::Last)> rpns_;
@@ -33,13 +56,20 @@ private:
     DataEntryMode dataEntryMode_;
     double pitchBendSensitivity_;
     double fineTuning_, coarseTuning_;
-    std::vector<std::unique_ptr<Voice>> voices_;
+    VoicePool voices_;
     std::size_t currentNoteID_;
-    std::mutex mutex_;
+    // number of frames rendered since last tick of control grid
+    std::size_t controlPhase_;
+    // controllers changed since last render, applied to voices once right before rendering
+    std::bitset<midi::NUM_CONTROLLERS> dirtyControllers_;
+    bool channelPressureDirty_, pitchBendDirty_;
 
     std::uint16_t getSelectedRPN() const;
 
-    void addVoice(std::unique_ptr<Voice> voice);
+    void addVoice(std::size_t slot);
+    void releaseVoice(Voice& voice, bool sustained);
+    void applyDirtyControllers();
+    void renderVoices(float* left, float* right, std::size_t numFrames);
     void updateRPN();
 };
 }
@@ -0,0 +1,40 @@
+#pragma once
+#include "envelope.h"
+#include "lfo.h"
+
+namespace primesynth {
+// control-rate state of all voices in a pool, indexed by slot
+struct ControlEngine {
+    EnvelopeBank volEnvs, modEnvs;
+    LFOBank vibLFOs, modLFOs;
+
+    ControlEngine(std::size_t size, double outputRate, unsigned int interval)
+        : volEnvs(size, outputRate, interval),
+          modEnvs(size, outputRate, interval),
+          vibLFOs(size, outputRate, interval),
+          modLFOs(size, outputRate, interval) {}
+
+    void setInterval(unsigned int interval) {
+        volEnvs.setInterval(interval);
+        modEnvs.setInterval(interval);
+        vibLFOs.setInterval(interval);
+        modLFOs.setInterval(interval);
+    }
+
+    void reset(std::size_t i) {
+        volEnvs.reset(i);
+        modEnvs.reset(i);
+        vibLFOs.reset(i);
+        modLFOs.reset(i);
+    }
+
+    // advances slots in [begin, end) by step, which is a fraction of control tick for voices started between ticks
+    // slots of finished voices may be included, as they are reset before being reused
+    void update(std::size_t begin, std::size_t end, double step = 1.0) {
+        volEnvs.update(begin, end, step);
+        modEnvs.update(begin, end, step);
+        vibLFOs.update(begin, end, step);
+        modLFOs.update(begin, end, step);
+    }
+};
+}
@@ -1,27 +1,41 @@
 #pragma once
 #include <array>
+#include <cstdint>
+#include <vector>
 
 namespace primesynth {
-class Envelope {
+// envelopes of all voices in a pool, stored as structure of arrays indexed by slot
+// so that they are updated together in one pass
+class EnvelopeBank {
 public:
-    enum class Phase { Delay, Attack, Hold, Decay, Sustain, Release, Finished };
+    enum class Phase : std::uint8_t { Delay, Attack, Hold, Decay, Sustain, Release, Finished };
 
-    Envelope(double outputRate, unsigned int interval);
+    EnvelopeBank(std::size_t size, double outputRate, unsigned int interval);
 
-    Phase getPhase() const;
-    double getValue() const;
+    // parameters set so far are not converted
+    void setInterval(unsigned int interval);
 
-    void setParameter(Phase phase, double param);
-    void release();
-    void update();
+    Phase getPhase(std::size_t i) const;
+    double getValue(std::size_t i) const;
+
+    // starts envelope of a new voice from delay phase
+    void reset(std::size_t i);
+    void setParameter(std::size_t i, Phase phase, double param);
+    void release(std::size_t i);
+    // advances envelopes in [begin, end) by step, in control ticks
+    void update(std::size_t begin, std::size_t end, double step = 1.0);
 
 private:
-    const double effectiveOutputRate_;
-    std::array<double, static_cast<std::size_t>(Phase::Finished)> params_;
-    Phase phase_;
-    unsigned int phaseSteps_;
-    double value_;
+    static constexpr std::size_t NUM_PHASES = static_cast<std::size_t>(Phase::Finished);
+
+    const double outputRate_;
+    double effectiveOutputRate_;
+    // params_[phase][i]
+    std::array<std::vector<double>, NUM_PHASES> params_;
+    std::vector<Phase> phases_;
+    std::vector<double> phaseSteps_;
+    std::vector<double> values_;
 
-    void changePhase(Phase phase);
+    void changePhase(std::size_t i, Phase phase);
 };
 }
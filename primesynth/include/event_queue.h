@@ -0,0 +1,23 @@
+#pragma once
+#include "ring_buffer.h"
+#include <array>
+#include <cstdint>
+
+namespace primesynth {
+struct MIDIEvent {
+    // longest SysEx the synthesizer responds to is 11 bytes
+    static constexpr std::size_t MAX_SYSEX_LENGTH = 16;
+
+    enum class Type : std::uint8_t { ShortMessage, SysEx };
+
+    // frame at which event takes effect
+    std::uint64_t frame;
+    Type type;
+    std::uint8_t sysExLength;
+    std::uint32_t param;
+    std::array<char, MAX_SYSEX_LENGTH> sysEx;
+};
+
+// queue of MIDI events from the thread calling processShortMessage/processSysEx to the rendering thread
+using EventQueue = RingBuffer<MIDIEvent>;
+}
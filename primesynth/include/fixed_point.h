@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 namespace primesynth {
 // 64 bit fixed-point number
@@ -13,10 +14,18 @@ public:
         : raw_((static_cast<std::uint64_t>(value) << 32) |
                static_cast<std::uint32_t>((value - static_cast<std::uint32_t>(value)) * (UINT32_MAX + 1.0))) {}
 
+    std::uint64_t getRaw() const {
+        return raw_;
+    }
+
     std::uint32_t getIntegerPart() const {
         return raw_ >> 32;
     }
 
+    std::uint32_t getRawFractionalPart() const {
+        return static_cast<std::uint32_t>(raw_);
+    }
+
     double getFractionalPart() const {
         return (raw_ & UINT32_MAX) / (UINT32_MAX + 1.0);
     }
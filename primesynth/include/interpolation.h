@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace primesynth {
+namespace interp {
+enum class Mode {
+    None,   // nearest neighbor
+    Linear, // 2-point linear
+    Cubic,  // 4-point Catmull-Rom spline
+    Sinc    // 8-point Blackman-windowed sinc
+};
+
+// interpolators read up to GUARD_POINTS points on each side of a position without bounds checks,
+// so sample data must be readable there
+static constexpr std::size_t GUARD_POINTS = 4;
+
+// positions of output frames in sample data
+// fractions are lower 32 bit of FixedPoint
+struct Positions {
+    const std::uint32_t* indices;
+    const std::uint32_t* fractions;
+};
+
+// gain ramp applied to interpolated samples
+struct Gain {
+    float amp, deltaAmp;
+    float left, right;
+};
+
+// accumulates interpolated samples into left and right
+void render(Mode mode, const std::int16_t* samples, const Positions& positions, std::size_t numFrames,
+            const Gain& gain, float* left, float* right);
+}
+}
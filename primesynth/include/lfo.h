@@ -1,49 +1,70 @@
 #pragma once
 #include "conversion.h"
+#include <cmath>
+#include <vector>
 
 namespace primesynth {
-class LFO {
+// triangle LFOs of all voices in a pool, stored as structure of arrays indexed by slot
+class LFOBank {
 public:
-    LFO(double outputRate, unsigned int interval)
-        : outputRate_(outputRate), interval_(interval), steps_(0), delay_(0), delta_(0.0), value_(0.0), up_(true) {}
+    LFOBank(std::size_t size, double outputRate, unsigned int interval)
+        : outputRate_(outputRate),
+          interval_(interval),
+          steps_(size, 0.0),
+          delays_(size, 0.0),
+          deltas_(size, 0.0),
+          values_(size, 0.0),
+          directions_(size, 1.0) {}
 
-    double getValue() const {
-        return value_;
+    // frequencies set so far are not converted
+    void setInterval(unsigned int interval) {
+        interval_ = interval;
     }
 
-    void setDelay(double delay) {
-        delay_ = static_cast<unsigned int>(outputRate_ * conv::timecentToSecond(delay));
+    double getValue(std::size_t i) const {
+        return values_[i];
     }
 
-    void setFrequency(double freq) {
-        delta_ = 4.0 * interval_ * conv::absoluteCentToHertz(freq) / outputRate_;
+    // starts LFO of a new voice
+    void reset(std::size_t i) {
+        steps_[i] = 0.0;
+        delays_[i] = 0.0;
+        deltas_[i] = 0.0;
+        values_[i] = 0.0;
+        directions_[i] = 1.0;
     }
 
-    void update() {
-        if (steps_ <= delay_) {
-            ++steps_;
-            return;
-        }
-        if (up_) {
-            value_ += delta_;
-            if (value_ > 1.0) {
-                value_ = 2.0 - value_;
-                up_ = false;
-            }
-        } else {
-            value_ -= delta_;
-            if (value_ < -1.0) {
-                value_ = -2.0 - value_;
-                up_ = true;
-            }
+    void setDelay(std::size_t i, double delay) {
+        // in control ticks
+        delays_[i] = std::floor(outputRate_ / interval_ * conv::timecentToSecond(delay));
+    }
+
+    void setFrequency(std::size_t i, double freq) {
+        deltas_[i] = 4.0 * interval_ * conv::absoluteCentToHertz(freq) / outputRate_;
+    }
+
+    // advances LFOs in [begin, end) by step, in control ticks
+    // written without branches so that compilers can vectorize it
+    void update(std::size_t begin, std::size_t end, double step = 1.0) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const bool delayed = steps_[i] <= delays_[i];
+            steps_[i] += delayed ? step : 0.0;
+
+            const double direction = directions_[i];
+            const double value = values_[i] + (delayed ? 0.0 : step * direction * deltas_[i]);
+            const bool overshot = direction > 0.0 && value > 1.0;
+            const bool undershot = direction < 0.0 && value < -1.0;
+            values_[i] = overshot ? 2.0 - value : (undershot ? -2.0 - value : value);
+            directions_[i] = overshot || undershot ? -direction : direction;
         }
     }
 
 private:
     const double outputRate_;
-    const unsigned int interval_;
-    unsigned int steps_, delay_;
-    double delta_, value_;
-    bool up_;
+    unsigned int interval_;
+    // in control ticks
+    std::vector<double> steps_, delays_, deltas_, values_;
+    // 1 while rising, -1 while falling
+    std::vector<double> directions_;
 };
 }
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+
+namespace primesynth {
+// read-only memory mapping of whole file
+// pages are loaded on demand and shared with other processes mapping the same file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const;
+    std::size_t size() const;
+
+private:
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#else
+    int fd_;
+#endif
+    const char* data_;
+    std::size_t size_;
+};
+}
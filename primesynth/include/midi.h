@@ -1,6 +1,7 @@
 #pragma once
 #include <cstddef>
 #include <cstdint>
+#include <ostream>
 
 namespace primesynth {
 namespace midi {
@@ -50,5 +51,11 @@ struct Bank {
 };
 
 std::uint16_t joinBytes(std::uint8_t msb, std::uint8_t lsb);
+// number of data bytes following status byte of channel message
+std::size_t getNumDataBytes(std::uint8_t status);
+
+// print messages in human readable form, one line each without flushing
+void printShortMessage(std::ostream& os, std::uint32_t param);
+void printSysEx(std::ostream& os, const char* data, std::size_t length);
 }
 }
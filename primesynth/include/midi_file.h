@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace primesynth {
+// Standard MIDI File (format 0 or 1) with all tracks merged into single list of events in time order
+class MIDIFile {
+public:
+    struct Event {
+        double time; // in seconds
+        // short message, used if sysEx is empty
+        std::uint32_t param;
+        // SysEx message including leading F0
+        std::vector<char> sysEx;
+    };
+
+    explicit MIDIFile(const std::string& filename);
+
+    const std::vector<Event>& getEvents() const;
+    // time of end of last track in seconds
+    double getLength() const;
+
+private:
+    std::vector<Event> events_;
+    double length_;
+};
+}
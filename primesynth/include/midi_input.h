@@ -1,21 +1,27 @@
 #pragma once
-#include "synthesizer.h"
+#include "midi_logger.h"
+#include "midi_scheduler.h"
 #include <atomic>
 #define NOMINMAX
 #include <Windows.h>
 
 namespace primesynth {
+// MIDI input device of WinMM, see MIDIStreamInput for other platforms
 class MIDIInput {
 public:
     struct SharedParam {
         Synthesizer& synth;
+        MIDIScheduler scheduler;
+        MIDILogger* logger;
         std::atomic_bool running;
         bool addingBufferRequested;
         std::mutex mutex;
         std::condition_variable cv;
     };
 
-    MIDIInput(Synthesizer& synth, UINT deviceID, bool verbose = false);
+    // received messages are logged to logger unless it is nullptr
+    // latency in seconds
+    MIDIInput(Synthesizer& synth, UINT deviceID, MIDILogger* logger = nullptr, double latency = 0.0);
     ~MIDIInput();
 
 private:
@@ -0,0 +1,43 @@
+#pragma once
+#include "ring_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace primesynth {
+// prints MIDI messages on low-priority thread so that threads receiving them never block on console I/O
+// messages are passed through wait-free queue, and are not printed if it is full
+class MIDILogger {
+public:
+    // capacity of queue in bytes
+    explicit MIDILogger(std::ostream& os, std::size_t capacity = 1 << 16);
+    // prints messages remaining in queue
+    ~MIDILogger();
+
+    MIDILogger(const MIDILogger&) = delete;
+    MIDILogger& operator=(const MIDILogger&) = delete;
+
+    // these must be called from single thread
+    void logShortMessage(std::uint32_t param);
+    void logSysEx(const char* data, std::size_t length);
+
+private:
+    enum class RecordType : char { ShortMessage, SysEx };
+
+    std::ostream& os_;
+    // records of type, parameter or length, and SysEx data
+    RingBuffer<char> queue_;
+    // used by thread calling log* to build records so that each of them is queued by single write
+    std::vector<char> record_;
+    std::atomic<std::size_t> numDropped_;
+    std::atomic_bool running_;
+    std::thread printingThread_;
+
+    void queueRecord(RecordType type, std::uint32_t value, const char* data, std::size_t length);
+    void doPrintingLoop();
+    // returns false if there was nothing to print
+    bool printQueued();
+};
+}
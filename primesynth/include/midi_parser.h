@@ -0,0 +1,33 @@
+#pragma once
+#include "event_queue.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace primesynth {
+// parses raw MIDI byte stream, as sent over MIDI cables, serial ports and pipes, into events
+// messages may be split across calls of parse, and running status is supported
+class MIDIParser {
+public:
+    MIDIParser();
+
+    // appends events of messages completed by data to events, with their frames set to 0
+    // system common and real-time messages are consumed but not reported as the synthesizer ignores them,
+    // and so are SysEx messages longer than MIDIEvent::MAX_SYSEX_LENGTH
+    void parse(const std::uint8_t* data, std::size_t size, std::vector<MIDIEvent>& events);
+
+private:
+    // status of message being received, 0 if data bytes are ignored
+    std::uint8_t status_;
+    // status of last channel message, reused for data bytes without status byte
+    std::uint8_t runningStatus_;
+    std::array<std::uint8_t, 2> dataBytes_;
+    std::size_t numDataBytes_, expectedDataBytes_;
+    bool inSysEx_;
+    std::size_t sysExLength_;
+    std::array<char, MIDIEvent::MAX_SYSEX_LENGTH> sysEx_;
+
+    void parseStatus(std::uint8_t status, std::vector<MIDIEvent>& events);
+    void parseData(std::uint8_t data, std::vector<MIDIEvent>& events);
+};
+}
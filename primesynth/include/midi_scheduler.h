@@ -0,0 +1,24 @@
+#pragma once
+#include "synthesizer.h"
+
+namespace primesynth {
+// converts arrival times of MIDI messages into frames at which they take effect
+// messages are scheduled at (time received + latency) to preserve their relative timing
+// 0 latency means they take effect as soon as possible
+class MIDIScheduler {
+public:
+    // latency in seconds
+    MIDIScheduler(const Synthesizer& synth, double latency);
+
+    // time in seconds since arbitrary origin
+    // returns frames in nondecreasing order as required by the synthesizer
+    std::uint64_t toFrame(double time);
+
+private:
+    const Synthesizer& synth_;
+    const double latencyFrames_;
+    bool anchored_;
+    double anchorTime_;
+    std::uint64_t anchorFrame_, lastFrame_;
+};
+}
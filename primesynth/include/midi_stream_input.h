@@ -0,0 +1,51 @@
+#pragma once
+#include "midi_logger.h"
+#include "midi_parser.h"
+#include "midi_scheduler.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace primesynth {
+// reads raw MIDI byte stream from file descriptor, such as pipe, UNIX socket or serial device node
+// messages are timestamped on arrival, and those received by single read are queued to the synthesizer at once
+class MIDIStreamInput {
+public:
+    // fd is not closed by MIDIStreamInput
+    // received messages are logged to logger unless it is nullptr
+    // latency in seconds, see MIDIScheduler
+    MIDIStreamInput(Synthesizer& synth, int fd, MIDILogger* logger = nullptr, double latency = 0.0);
+    // opens file such as FIFO or device node, "-" means stdin
+    MIDIStreamInput(Synthesizer& synth, const std::string& filename, MIDILogger* logger = nullptr,
+                    double latency = 0.0);
+    ~MIDIStreamInput();
+
+    MIDIStreamInput(const MIDIStreamInput&) = delete;
+    MIDIStreamInput& operator=(const MIDIStreamInput&) = delete;
+
+    // whether any message has been queued
+    bool hasReceived() const;
+    // whether end of stream has been reached and all messages have been queued
+    bool hasEnded() const;
+
+private:
+    Synthesizer& synth_;
+    const int fd_;
+    const bool ownsFD_;
+    MIDILogger* const logger_;
+    MIDIParser parser_;
+    MIDIScheduler scheduler_;
+    std::vector<MIDIEvent> events_;
+    std::atomic_bool running_, received_, ended_;
+#ifdef _WIN32
+    // handle of reading thread for cancelling blocking read, set by the thread itself
+    std::atomic<void*> readingThreadHandle_;
+#endif
+    std::thread readingThread_;
+
+    MIDIStreamInput(Synthesizer& synth, int fd, bool ownsFD, MIDILogger* logger, double latency);
+    void doReadingLoop();
+    void queueEvents();
+};
+}
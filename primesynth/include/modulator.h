@@ -1,23 +1,87 @@
 #pragma once
 #include "soundfont_spec.h"
+#include <array>
+#include <vector>
 
 namespace primesynth {
+static constexpr std::size_t NUM_GENERATORS = static_cast<std::size_t>(sf::Generator::Last);
+static constexpr std::size_t MAX_MODULATORS = 64;
+static constexpr std::size_t NUM_CONTROLLER_INDICES = 128;
+static constexpr std::size_t CURVE_RESOLUTION = 128;
+
+// source curve of modulators sampled at positions 0, 1, ..., CURVE_RESOLUTION and linearly interpolated in between
+// position is MIDI controller value, or equivalent of it for other sources
+struct ModulatorCurve {
+    std::array<double, CURVE_RESOLUTION + 1> values;
+    // 0 for switches, which keep value of lower point, 1 otherwise
+    double interpolation;
+
+    double operator()(double position) const;
+};
+
+// modulator parameter with source curves resolved, which are nullptr for sources without controller
+struct CompiledModulator {
+    sf::ModList param;
+    const ModulatorCurve* sourceCurve;
+    const ModulatorCurve* amountSourceCurve;
+    // converts source values into curve positions
+    double sourceScale, amountSourceScale;
+};
+
+// modulators of a zone compiled into tables from sources to modulators and destinations
+// shared by all voices playing the zone
+class ModulatorRouting {
+public:
+    struct Route {
+        // indices of modulators whose source or amount source is the controller
+        std::vector<std::uint8_t> modulators;
+        // destinations of the modulators without duplicates
+        std::vector<sf::Generator> destinations;
+    };
+
+    // modulators beyond MAX_MODULATORS, those with unsupported destinations (e.g. links),
+    // and those with unknown source types are ignored
+    explicit ModulatorRouting(const std::vector<sf::ModList>& params);
+
+    std::size_t size() const;
+    const CompiledModulator& getModulator(std::size_t i) const;
+    bool canBeNegative(std::size_t i) const;
+    const Route& getRoute(sf::GeneralController controller) const;
+    const Route& getRoute(std::uint8_t midiController) const;
+    // MIDI controllers used by any modulators, and destinations of the modulators without duplicates
+    const std::vector<std::uint8_t>& getMIDIControllers() const;
+    const std::vector<sf::Generator>& getMIDIDestinations() const;
+    // indices of modulators whose destination is given generator, in order of parameters
+    const std::uint8_t* beginDestination(sf::Generator destination) const;
+    const std::uint8_t* endDestination(sf::Generator destination) const;
+
+private:
+    std::vector<CompiledModulator> modulators_;
+    // routes_[0] is empty and referred by controllers used by no modulators
+    std::vector<Route> routes_;
+    std::array<std::uint16_t, NUM_CONTROLLER_INDICES> sfRouteIndices_, midiRouteIndices_;
+    std::vector<std::uint8_t> midiControllers_;
+    std::vector<sf::Generator> midiDestinations_;
+    // modulator indices sorted by destination, and offsets of each destination in them
+    std::vector<std::uint8_t> byDestination_;
+    std::array<std::uint8_t, NUM_GENERATORS + 1> destinationOffsets_;
+
+    void buildRoutes(sf::ControllerPalette palette, std::array<std::uint16_t, NUM_CONTROLLER_INDICES>& routeIndices);
+};
+
+// per-voice state of a modulator, whose parameter is held by ModulatorRouting
 class Modulator {
 public:
-    explicit Modulator(const sf::ModList& param);
+    Modulator();
 
-    sf::Generator getDestination() const;
-    std::int16_t getAmount() const;
-    bool canBeNegative() const;
     double getValue() const;
 
-    bool updateSFController(sf::GeneralController controller, double value);
-    bool updateMIDIController(std::uint8_t controller, std::uint8_t value);
+    void updateSFController(const CompiledModulator& mod, sf::GeneralController controller, double value);
+    void updateMIDIController(const CompiledModulator& mod, std::uint8_t controller, std::uint8_t value);
 
 private:
-    const sf::ModList param_;
     double source_, amountSource_, value_;
 
-    void calculateValue();
+    void calculateValue(const sf::ModList& param);
 };
 }
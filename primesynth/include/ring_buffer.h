@@ -1,46 +1,109 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <vector>
 
 namespace primesynth {
+// wait-free single-producer single-consumer ring buffer
+// capacity need not be power of 2: indices run over [0, 2 * capacity) so that full and empty are distinguished
+// without wasting an element, and are reduced to positions only once per operation
+template <typename T>
 class RingBuffer {
 public:
-    explicit RingBuffer(std::size_t size) : size_(size), data_(size) {}
+    explicit RingBuffer(std::size_t capacity) : data_(capacity), head_(0), tail_(0) {}
 
-    bool empty() const {
-        return start_ >= end_;
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    std::size_t capacity() const {
+        return data_.size();
     }
 
-    bool full() const {
-        return end_ - start_ >= size_;
+    // called only by producer
+    std::size_t writable() const {
+        return capacity() - distance(head_.load(std::memory_order_acquire), tail_.load(std::memory_order_relaxed));
     }
 
-    std::size_t size() const {
-        return end_ - start_;
+    // called only by consumer
+    std::size_t readable() const {
+        return distance(head_.load(std::memory_order_relaxed), tail_.load(std::memory_order_acquire));
     }
 
-    std::size_t capacity() const {
-        return size_ - size();
+    // called only by producer
+    // returns false if buffer is full
+    bool push(const T& value) {
+        return write(&value, 1) == 1;
     }
 
-    void push(float t) {
-        data_.at(mask(end_++)) = t;
+    // called only by producer
+    // returns number of elements written, which is less than count if buffer becomes full
+    std::size_t write(const T* values, std::size_t count) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        count = std::min(count, capacity() - distance(head_.load(std::memory_order_acquire), tail));
+
+        // at most two contiguous regions, before and after wrapping around
+        const std::size_t position = toPosition(tail);
+        const std::size_t first = std::min(count, capacity() - position);
+        std::copy(values, values + first, data_.begin() + position);
+        std::copy(values + first, values + count, data_.begin());
+
+        tail_.store(advance(tail, count), std::memory_order_release);
+        return count;
     }
 
-    float shift() {
-        return data_.at(mask(start_++));
+    // called only by consumer
+    // returns nullptr if buffer is empty
+    const T* front() const {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &data_[toPosition(head)];
     }
 
-    void clear() {
-        start_ = end_;
+    // called only by consumer, after front() returned an element
+    void pop() {
+        discard(1);
+    }
+
+    // called only by consumer
+    // returns number of elements read, which is less than count if buffer becomes empty
+    std::size_t read(T* values, std::size_t count) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        count = std::min(count, distance(head, tail_.load(std::memory_order_acquire)));
+
+        const std::size_t position = toPosition(head);
+        const std::size_t first = std::min(count, capacity() - position);
+        std::copy(data_.cbegin() + position, data_.cbegin() + position + first, values);
+        std::copy(data_.cbegin(), data_.cbegin() + (count - first), values + first);
+
+        head_.store(advance(head, count), std::memory_order_release);
+        return count;
+    }
+
+    // called only by consumer, count must not exceed readable()
+    void discard(std::size_t count) {
+        head_.store(advance(head_.load(std::memory_order_relaxed), count), std::memory_order_release);
     }
 
 private:
-    std::size_t size_;
-    std::vector<float> data_;
-    std::size_t start_ = 0, end_ = 0;
+    std::vector<T> data_;
+    // indices are written by different threads, keep them on separate cache lines
+    std::atomic<std::size_t> head_;
+    char padding_[64 - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> tail_;
+
+    std::size_t distance(std::size_t head, std::size_t tail) const {
+        return tail >= head ? tail - head : tail + 2 * capacity() - head;
+    }
+
+    std::size_t advance(std::size_t index, std::size_t count) const {
+        index += count;
+        return index >= 2 * capacity() ? index - 2 * capacity() : index;
+    }
 
-    std::size_t mask(std::size_t i) const {
-        return i & (size_ - 1);
+    std::size_t toPosition(std::size_t index) const {
+        return index >= capacity() ? index - capacity() : index;
     }
 };
 }
@@ -1,10 +1,14 @@
 #pragma once
+#include "mapped_file.h"
+#include "midi.h"
+#include "modulator.h"
 #include "soundfont_spec.h"
 #include <array>
+#include <fstream>
+#include <memory>
 #include <vector>
 
 namespace primesynth {
-static constexpr std::size_t NUM_GENERATORS = static_cast<std::size_t>(sf::Generator::Last);
 static constexpr std::uint16_t PERCUSSION_BANK = 128;
 
 struct Sample {
@@ -12,9 +16,19 @@ struct Sample {
     std::uint32_t start, end, startLoop, endLoop, sampleRate;
     std::int8_t key, correction;
     double minAtten;
-    const std::vector<std::int16_t>& buffer;
-
-    Sample(const sf::Sample& sample, const std::vector<std::int16_t>& sampleBuffer);
+    // whole sample data of SoundFont, or copy of the sample if it is too close to either end of memory-mapped data
+    // voices play only positions at least interp::GUARD_POINTS away from both ends of it
+    const std::int16_t* buffer;
+    std::size_t bufferSize;
+    // copy of points around loop end, which continue from loop start instead of loop end, is at index loopSeam
+    // of seamBuffer and covers positions [endLoop - 2 * GUARD_POINTS, endLoop + 2 * GUARD_POINTS)
+    // seamBuffer is buffer unless sample data is memory-mapped, and nullptr if there is no copy
+    const std::int16_t* seamBuffer;
+    std::size_t loopSeam;
+
+    // scanning sample data for minAtten touches all of it, so it can be skipped to keep memory-mapped data unloaded
+    // minAtten is 0 then, and voices are kept until their envelope alone makes them inaudible
+    Sample(const sf::Sample& sample, const std::int16_t* sampleBuffer, std::size_t sampleBufferSize, bool scanPeak);
 };
 
 class GeneratorSet {
@@ -72,6 +86,14 @@ struct Instrument {
                const std::vector<sf::ModList>& imod, const std::vector<sf::GenList>& igen);
 };
 
+// fully resolved parameters of a voice, combined from a preset zone and an instrument zone
+struct VoiceTemplate {
+    Zone::Range keyRange, velocityRange;
+    const Sample* sample;
+    GeneratorSet generators;
+    ModulatorRouting modulators;
+};
+
 class SoundFont;
 
 struct Preset {
@@ -79,6 +101,10 @@ struct Preset {
     std::uint16_t bank, presetID;
     std::vector<Zone> zones;
     const SoundFont& soundFont;
+    // built from zones on load so that note-on does not need to resolve zones
+    std::vector<VoiceTemplate> voiceTemplates;
+    // indices of voiceTemplates whose key ranges contain each key, in order of zones
+    std::array<std::vector<std::size_t>, midi::MAX_KEY + 1> voiceTemplatesByKey;
 
     Preset(std::vector<sf::PresetHeader>::const_iterator phdrIter, const std::vector<sf::Bag>& pbag,
            const std::vector<sf::ModList>& pmod, const std::vector<sf::GenList>& pgen, const SoundFont& sfont);
@@ -86,7 +112,8 @@ struct Preset {
 
 class SoundFont {
 public:
-    explicit SoundFont(const std::string& filename);
+    // if memoryMapped is true, sample data is not read into memory but mapped from the file
+    explicit SoundFont(const std::string& filename, bool memoryMapped = false);
 
     const std::string& getName() const;
     const std::vector<Sample>& getSamples() const;
@@ -96,11 +123,16 @@ public:
 private:
     std::string name_;
     std::vector<std::int16_t> sampleBuffer_;
+    std::unique_ptr<MappedFile> mappedFile_;
+    const std::int16_t* sampleData_;
+    std::size_t sampleDataSize_;
     std::vector<Sample> samples_;
     std::vector<Instrument> instruments_;
     std::vector<std::shared_ptr<const Preset>> presets_;
 
     void readInfoChunk(std::ifstream& ifs, std::size_t size);
+    void addLoopSeams();
+    void addMappedCopies();
     void readSdtaChunk(std::ifstream& ifs, std::size_t size);
     void readPdtaChunk(std::ifstream& ifs, std::size_t size);
 };
@@ -14,8 +14,10 @@
 #include <thread>
 #include <vector>
 
+#ifdef _WIN32
 #define NOMINMAX
 #include <Windows.h>
+#endif
 
 #include "third_party/cmdline.h"
 #include "third_party/portaudio.h"
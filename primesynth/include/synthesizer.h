@@ -1,27 +1,75 @@
 #pragma once
 #include "channel.h"
+#include "event_queue.h"
+#include "thread_pool.h"
+#include <unordered_map>
 
 namespace primesynth {
 class Synthesizer {
 public:
     Synthesizer(double outputRate = 44100, std::size_t numChannels = 16);
 
-    StereoValue render() const;
+    void renderBlock(float* left, float* right, std::size_t numFrames);
+    void renderBlock(float* buffer, std::size_t numFrames);
 
-    void loadSoundFont(const std::string& filename);
+    void loadSoundFont(const std::string& filename, bool memoryMapped = false);
     void setVolume(double volume);
+    void setInterpolation(interp::Mode interpolation);
+    // number of frames between updates of envelopes, LFOs and pitch of voices (16, 32, 64 or 128)
+    // stops all voices, must not be called while rendering
+    void setCalcInterval(unsigned int interval);
+    // maximum number of voices sounding at once across all channels
+    void setPolyphony(std::size_t polyphony);
+    void setStealingPolicy(StealingPolicy policy);
+    // renders channels in parallel if numThreads > 1
+    // must not be called while rendering
+    void setNumThreads(std::size_t numThreads);
+    void setChannelPriority(std::size_t channel, int priority);
     void setMIDIStandard(midi::Standard midiStandard, bool fixed = false);
-    void processShortMessage(std::uint32_t param);
-    void processSysEx(const char* data, std::size_t length);
+    double getSampleRate() const;
+    // number of frames rendered so far
+    std::uint64_t getCurrentFrame() const;
+    // largest number of frames rendered by one renderBlock so far, e.g. period of audio device in its callback
+    // rendering runs ahead of audio output by an amount varying up to this
+    std::size_t getLargestBlockSize() const;
+
+    // MIDI messages are queued and take effect exactly at given frame,
+    // or at beginning of next renderBlock if the frame has already been rendered
+    // these must be called from single thread, which may differ from rendering thread,
+    // in nondecreasing order of frame
+    // return false if the message was dropped because event queue is full,
+    // or because SysEx is longer than MIDIEvent::MAX_SYSEX_LENGTH, which no SysEx the synthesizer responds to is
+    bool processShortMessage(std::uint32_t param, std::uint64_t frame = 0);
+    bool processSysEx(const char* data, std::size_t length, std::uint64_t frame = 0);
+    // queues events at once, returns number of events queued from beginning of events
+    std::size_t processEvents(const MIDIEvent* events, std::size_t count);
 
 private:
+    const double outputRate_;
     midi::Standard midiStd_, defaultMIDIStd_;
     bool stdFixed_;
     std::vector<std::unique_ptr<Channel>> channels_;
     std::vector<std::unique_ptr<SoundFont>> soundFonts_;
+    // maps (bank, preset number) to preset with fallbacks already resolved
+    std::unordered_map<std::uint32_t, std::shared_ptr<const Preset>> presetIndex_;
     double volume_;
+    std::size_t polyphony_;
+    StealingPolicy stealingPolicy_;
+    std::vector<float> leftBuffer_, rightBuffer_;
+    std::vector<float> channelBuffers_;
+    std::unique_ptr<ThreadPool> threadPool_;
+    EventQueue eventQueue_;
+    std::atomic<std::uint64_t> currentFrame_;
+    std::atomic<std::size_t> largestBlockSize_;
 
+    std::size_t renderSegment(std::size_t maxFrames);
+    void renderChannels(std::size_t numFrames);
+    std::size_t countVoices() const;
+    void limitPolyphony();
+    void updatePresetIndex();
     std::shared_ptr<const Preset> findPreset(std::uint16_t bank, std::uint16_t presetID) const;
+    void handleShortMessage(std::uint32_t param);
+    void handleSysEx(const char* data, std::size_t length);
     void processChannelMessage(unsigned long param);
 };
 }
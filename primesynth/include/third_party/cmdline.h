@@ -730,7 +730,7 @@ private:
         actual=read(value);
         has=true;
       }
-      catch(const std::exception){
+      catch(const std::exception&){
         return false;
       }
       return true;
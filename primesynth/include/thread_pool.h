@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace primesynth {
+// fixed set of worker threads running batches of indexed tasks
+// tasks are split evenly among workers, and idle workers steal tasks from the others
+class ThreadPool {
+public:
+    // the thread calling run() takes part in the work, so numThreads - 1 threads are spawned
+    explicit ThreadPool(std::size_t numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::size_t getNumThreads() const;
+
+    // calls task(i) for each i in [0, numTasks) and returns after all of them have finished
+    template <typename F>
+    void run(std::size_t numTasks, F& task) {
+        dispatch(numTasks, [](void* t, std::size_t i) { (*static_cast<F*>(t))(i); }, &task);
+    }
+
+private:
+    // range of task indices packed into single word, so that owner and thieves can update it with one CAS
+    // owner takes tasks from the front and thieves take them from the back
+    // padded to cache line size to avoid false sharing
+    // (padding rather than alignas, as over-aligned types are not guaranteed to be allocated properly before C++17)
+    struct Worker {
+        std::atomic<std::uint64_t> range{0};
+        char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+
+    using TaskFunction = void (*)(void*, std::size_t);
+
+    std::unique_ptr<Worker[]> workers_;
+    const std::size_t numThreads_;
+    std::vector<std::thread> threads_;
+    TaskFunction taskFunc_;
+    void* task_;
+    std::atomic<std::size_t> pending_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::uint64_t generation_;
+    bool stopping_;
+
+    void dispatch(std::size_t numTasks, TaskFunction func, void* task);
+    void workerLoop(std::size_t id);
+    void work(std::size_t id);
+    bool popTask(std::size_t worker, std::size_t& index);
+    bool stealTask(std::size_t worker, std::size_t& index);
+};
+}
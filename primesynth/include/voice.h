@@ -1,32 +1,58 @@
 #pragma once
-#include "envelope.h"
+#include "control_engine.h"
 #include "fixed_point.h"
-#include "lfo.h"
+#include "interpolation.h"
 #include "modulator.h"
 #include "soundfont.h"
 #include "stereo_value.h"
 
 namespace primesynth {
+// number of frames between control-rate updates of voices is one of 16, 32, 64 and 128
+// shorter intervals make modulation smoother at the cost of CPU time
+static constexpr unsigned int DEFAULT_CALC_INTERVAL = 64;
+static constexpr unsigned int MAX_CALC_INTERVAL = 128;
+
+bool isValidCalcInterval(unsigned int interval);
+
 class Voice {
 public:
-    enum class State { Playing, Sustained, Released, Finished };
+    enum class State { Playing, Sustained, Released, Stolen, Finished };
 
-    Voice(std::size_t noteID, double outputRate, const Sample& sample, const GeneratorSet& generators,
-          const ModulatorParameterSet& modparams, std::uint8_t key, std::uint8_t velocity);
+    // control state of the voice is stored in slot of the engine
+    Voice(ControlEngine& control, std::size_t slot, std::size_t noteID, double outputRate, const Sample& sample,
+          const GeneratorSet& generators, const ModulatorRouting& modulatorRouting, std::uint8_t key,
+          std::uint8_t velocity);
 
     std::size_t getNoteID() const;
     std::uint8_t getActualKey() const;
     std::int16_t getExclusiveClass() const;
     const State& getStatus() const;
-    StereoValue render() const;
+    // number of frames rendered so far
+    unsigned int getAge() const;
+    // number of frames rendered since release
+    unsigned int getReleaseAge() const;
+    // current amplitude including envelope and attenuation
+    double getLoudness() const;
 
     void setPercussion(bool percussion);
     void updateSFController(sf::GeneralController controller, double value);
     void updateMIDIController(std::uint8_t controller, std::uint8_t value);
+    // updates all MIDI controllers used by modulators at once
+    void updateMIDIControllers(const std::array<std::uint8_t, midi::NUM_CONTROLLERS>& values);
     void updateFineTuning(double fineTuning);
     void updateCoarseTuning(double coarseTuning);
     void release(bool sustained);
-    void update();
+    // fades out linearly over numFrames regardless of envelope, then finishes
+    // used instead of stopping immediately, which would click
+    void steal(std::size_t numFrames);
+    // control-rate update is split around advancing control engine, which is done for many voices at once
+    // prepareUpdate finishes the voice and returns false if it is no longer audible
+    bool prepareUpdate();
+    // numFrames is number of frames until next update
+    void update(std::size_t numFrames);
+    // renders frames without updating control-rate parameters
+    // numFrames must not exceed MAX_CALC_INTERVAL
+    void render(float* left, float* right, std::size_t numFrames, interp::Mode interpolation);
 
 private:
     enum class SampleMode { UnLooped, Looped, UnUsed, LoopedUntilRelease };
@@ -35,30 +61,43 @@ private:
         SampleMode mode;
         double pitch;
         std::uint32_t start, end, startLoop, endLoop;
+        // looping positions in [seamBegin, seamEnd) are read from loop seam in seamBuffer, shifted by seamOffset,
+        // and wrap back by loop length at seamEnd
+        std::uint32_t seamBegin, seamEnd, seamOffset;
+        const std::int16_t* seamBuffer;
     };
 
     const std::size_t noteID_;
     const std::uint8_t actualKey_;
-    const std::vector<std::int16_t>& sampleBuffer_;
+    const std::int16_t* const sampleBuffer_;
     GeneratorSet generators_;
     RuntimeSample rtSample_;
     int keyScaling_;
-    std::vector<Modulator> modulators_;
+    const ModulatorRouting& modulatorRouting_;
+    std::array<Modulator, MAX_MODULATORS> modulators_;
     double minAtten_;
     std::array<double, NUM_GENERATORS> modulated_;
     bool percussion_;
     double fineTuning_, coarseTuning_;
     double deltaIndexRatio_;
-    unsigned int steps_;
+    unsigned int steps_, releasedSteps_;
     State status_;
     double voicePitch_;
     FixedPoint index_, deltaIndex_;
     StereoValue volume_;
     double amp_, deltaAmp_;
-    Envelope volEnv_, modEnv_;
-    LFO vibLFO_, modLFO_;
+    // remaining frames of fade-out after being stolen
+    std::size_t fadeFrames_;
+    ControlEngine& control_;
+    const std::size_t slot_;
 
     double getModulatedGenerator(sf::Generator type) const;
     void updateModulatedParams(sf::Generator destination);
+    // records positions of up to numFrames frames in buffer while moving index
+    // returns number of recorded frames, which is less than numFrames if voice has reached end of sample
+    // or positions after them are in another buffer
+    template <bool Looping>
+    std::size_t advance(std::uint32_t* indices, std::uint32_t* fractions, std::size_t numFrames,
+                        const std::int16_t*& buffer);
 };
 }
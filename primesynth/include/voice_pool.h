@@ -0,0 +1,379 @@
+#pragma once
+#include "voice.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <initializer_list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace primesynth {
+enum class StealingPolicy {
+    OldestReleased, // released voices first, then oldest playing ones
+    Quietest,       // voices with lowest current amplitude
+    LowestPriority  // voices on channel with lowest priority, then same as OldestReleased
+};
+
+// fixed number of voices stored contiguously
+// slots of finished voices are recycled, and voices are destroyed only when their slots are reused,
+// so that voices are never allocated or freed one by one
+//
+// live voices are also kept in intrusive lists ordered by age and grouped by loudness
+// so that a victim of voice stealing is found without scanning all voices
+//
+// envelopes and LFOs of voices are held by the pool in a ControlEngine and updated for all voices in one pass
+class VoicePool {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    // loudness levels are 6 dB apart, the last one covers everything below -90 dB
+    static constexpr std::size_t NUM_LOUDNESS_LEVELS = 16;
+
+    class Iterator {
+    public:
+        Iterator(VoicePool& pool, std::vector<std::size_t>::const_iterator it) : pool_(pool), it_(it) {}
+
+        Voice& operator*() const {
+            return pool_.at(*it_);
+        }
+
+        Iterator& operator++() {
+            ++it_;
+            return *this;
+        }
+
+        bool operator!=(const Iterator& b) const {
+            return it_ != b.it_;
+        }
+
+    private:
+        VoicePool& pool_;
+        std::vector<std::size_t>::const_iterator it_;
+    };
+
+    VoicePool(std::size_t capacity, double outputRate)
+        : storage_(std::make_unique<Storage[]>(capacity)),
+          control_(capacity, outputRate, DEFAULT_CALC_INTERVAL),
+          calcInterval_(DEFAULT_CALC_INTERVAL),
+          constructed_(capacity, false),
+          released_(capacity, false),
+          loudness_(capacity, 0),
+          ageLinks_(capacity),
+          loudnessLinks_(capacity),
+          numLive_(0),
+          numStolen_(0) {
+        active_.reserve(capacity);
+        free_.reserve(capacity);
+        updating_.reserve(capacity);
+        for (std::size_t i = capacity; i > 0; --i) {
+            free_.push_back(i - 1);
+        }
+    }
+
+    ~VoicePool() {
+        for (std::size_t i = 0; i < constructed_.size(); ++i) {
+            if (constructed_.at(i)) {
+                at(i).~Voice();
+            }
+        }
+    }
+
+    VoicePool(const VoicePool&) = delete;
+    VoicePool& operator=(const VoicePool&) = delete;
+
+    Iterator begin() {
+        return {*this, active_.cbegin()};
+    }
+
+    Iterator end() {
+        return {*this, active_.cend()};
+    }
+
+    // number of voices which are neither finished nor stolen
+    std::size_t size() const {
+        return numLive_;
+    }
+
+    // number of stolen voices which are still fading out
+    std::size_t getNumStolen() const {
+        return numStolen_;
+    }
+
+    Voice& at(std::size_t slot) {
+        return *reinterpret_cast<Voice*>(&storage_[slot]);
+    }
+
+    const Voice& at(std::size_t slot) const {
+        return *reinterpret_cast<const Voice*>(&storage_[slot]);
+    }
+
+    std::size_t slotOf(const Voice& voice) const {
+        return reinterpret_cast<const Storage*>(&voice) - storage_.get();
+    }
+
+    // takes a free slot out of the pool
+    // returns npos if the pool is full
+    std::size_t acquire() {
+        if (free_.empty()) {
+            return npos;
+        }
+        const std::size_t slot = free_.back();
+        free_.pop_back();
+        return slot;
+    }
+
+    // takes the slot of a voice out of the pool when it is full, stopping the voice at once unlike steal
+    // voices fading out after being stolen are taken first, then the oldest released or playing one
+    // returns npos if all voices have just started
+    std::size_t reclaim() {
+        auto it = std::find_if(active_.begin(), active_.end(),
+                               [this](std::size_t slot) { return at(slot).getStatus() == Voice::State::Stolen; });
+        if (it != active_.end()) {
+            --numStolen_;
+        } else {
+            const std::size_t victim = findVictim(StealingPolicy::OldestReleased);
+            if (victim == npos) {
+                return npos;
+            }
+            it = std::find(active_.begin(), active_.end(), victim);
+            unlink(victim);
+        }
+        const std::size_t slot = *it;
+        active_.erase(it);
+        return slot;
+    }
+
+    // constructs a voice in an acquired slot, destroying the voice previously stored in it
+    template <typename... Args>
+    Voice& construct(std::size_t slot, Args&&... args) {
+        if (constructed_.at(slot)) {
+            at(slot).~Voice();
+            constructed_.at(slot) = false;
+        }
+        new (&storage_[slot]) Voice(control_, slot, std::forward<Args>(args)...);
+        constructed_.at(slot) = true;
+        return at(slot);
+    }
+
+    // makes a voice in an acquired slot visible to iteration
+    void activate(std::size_t slot) {
+        active_.push_back(slot);
+        released_.at(slot) = false;
+        playing_.pushBack(ageLinks_, slot);
+        // new voices are assumed to be loud until rendered
+        loudness_.at(slot) = 0;
+        byLoudness_.front().pushBack(loudnessLinks_, slot);
+        ++numLive_;
+    }
+
+    // moves a voice to the list of released voices if it has just been released
+    void notifyReleased(const Voice& voice) {
+        const std::size_t slot = slotOf(voice);
+        if (voice.getStatus() == Voice::State::Released && !released_.at(slot)) {
+            playing_.remove(ageLinks_, slot);
+            releasedByAge_.pushBack(ageLinks_, slot);
+            released_.at(slot) = true;
+        }
+    }
+
+    // regroups a voice by its current loudness, called after rendering
+    void updateLoudness(const Voice& voice) {
+        if (voice.getStatus() == Voice::State::Stolen || voice.getStatus() == Voice::State::Finished) {
+            return;
+        }
+        const std::size_t slot = slotOf(voice);
+        const std::uint8_t level = toLoudnessLevel(voice.getLoudness());
+        if (level != loudness_.at(slot)) {
+            byLoudness_.at(loudness_.at(slot)).remove(loudnessLinks_, slot);
+            byLoudness_.at(level).pushBack(loudnessLinks_, slot);
+            loudness_.at(slot) = level;
+        }
+    }
+
+    // returns the voice which should be stolen first within this pool, or npos if there is none
+    // voices which have not been rendered yet are never chosen
+    std::size_t findVictim(StealingPolicy policy) const {
+        if (policy == StealingPolicy::Quietest) {
+            for (std::size_t i = NUM_LOUDNESS_LEVELS; i > 0; --i) {
+                const std::size_t slot = byLoudness_.at(i - 1).front();
+                if (slot != npos && at(slot).getAge() > 0) {
+                    return slot;
+                }
+            }
+            return npos;
+        }
+
+        for (const SlotList* list : {&releasedByAge_, &playing_}) {
+            const std::size_t slot = list->front();
+            if (slot != npos && at(slot).getAge() > 0) {
+                return slot;
+            }
+        }
+        return npos;
+    }
+
+    unsigned int getCalcInterval() const {
+        return calcInterval_;
+    }
+
+    // all voices are stopped, as their envelopes and LFOs are timed in control ticks
+    void setCalcInterval(unsigned int interval) {
+        clear();
+        control_.setInterval(interval);
+        calcInterval_ = interval;
+    }
+
+    // updates control-rate parameters of voices
+    // phase is number of frames since last tick of control grid, which is shared by all voices
+    // all voices are updated on ticks, and new voices are also updated before they are first rendered
+    // by the fraction of tick they are rendered for until next tick
+    void updateControl(std::size_t phase) {
+        const bool tick = phase == 0;
+        std::size_t end = 0;
+        updating_.clear();
+        for (const std::size_t slot : active_) {
+            Voice& voice = at(slot);
+            if (voice.getStatus() != Voice::State::Finished && (tick || voice.getAge() == 0) &&
+                voice.prepareUpdate()) {
+                updating_.push_back(slot);
+                end = std::max(end, slot + 1);
+            }
+        }
+
+        if (tick) {
+            control_.update(0, end);
+        } else {
+            const double step = static_cast<double>(calcInterval_ - phase) / calcInterval_;
+            for (const std::size_t slot : updating_) {
+                control_.update(slot, slot + 1, step);
+            }
+        }
+
+        for (const std::size_t slot : updating_) {
+            at(slot).update(calcInterval_ - phase);
+        }
+    }
+
+    bool isReleased(std::size_t slot) const {
+        return released_.at(slot);
+    }
+
+    std::uint8_t getLoudnessLevel(std::size_t slot) const {
+        return loudness_.at(slot);
+    }
+
+    // fades out a voice over fadeFrames, see Voice::steal
+    // it can no longer be found as a victim, and its slot is recycled on removeFinished after it has faded out
+    void steal(std::size_t slot, std::size_t fadeFrames) {
+        at(slot).steal(fadeFrames);
+        unlink(slot);
+        ++numStolen_;
+    }
+
+    void removeFinished() {
+        auto it = active_.begin();
+        for (const std::size_t slot : active_) {
+            if (at(slot).getStatus() == Voice::State::Finished) {
+                if (isLinked(slot)) {
+                    unlink(slot);
+                } else {
+                    --numStolen_;
+                }
+                free_.push_back(slot);
+            } else {
+                *it++ = slot;
+            }
+        }
+        active_.erase(it, active_.end());
+    }
+
+    void clear() {
+        free_.insert(free_.end(), active_.cbegin(), active_.cend());
+        active_.clear();
+        playing_ = {};
+        releasedByAge_ = {};
+        byLoudness_ = {};
+        numLive_ = 0;
+        numStolen_ = 0;
+    }
+
+private:
+    using Storage = std::aligned_storage<sizeof(Voice), alignof(Voice)>::type;
+
+    struct Link {
+        std::size_t prev = npos, next = npos;
+        bool linked = false;
+    };
+
+    // doubly linked list of slots, links are stored outside of the list
+    class SlotList {
+    public:
+        std::size_t front() const {
+            return head_;
+        }
+
+        void pushBack(std::vector<Link>& links, std::size_t slot) {
+            Link& link = links.at(slot);
+            link.prev = tail_;
+            link.next = npos;
+            link.linked = true;
+            if (tail_ == npos) {
+                head_ = slot;
+            } else {
+                links.at(tail_).next = slot;
+            }
+            tail_ = slot;
+        }
+
+        void remove(std::vector<Link>& links, std::size_t slot) {
+            Link& link = links.at(slot);
+            if (link.prev == npos) {
+                head_ = link.next;
+            } else {
+                links.at(link.prev).next = link.next;
+            }
+            if (link.next == npos) {
+                tail_ = link.prev;
+            } else {
+                links.at(link.next).prev = link.prev;
+            }
+            link = {};
+        }
+
+    private:
+        std::size_t head_ = npos, tail_ = npos;
+    };
+
+    std::unique_ptr<Storage[]> storage_;
+    ControlEngine control_;
+    unsigned int calcInterval_;
+    std::vector<bool> constructed_, released_;
+    std::vector<std::uint8_t> loudness_;
+    std::vector<std::size_t> active_, free_, updating_;
+    std::vector<Link> ageLinks_, loudnessLinks_;
+    SlotList playing_, releasedByAge_;
+    std::array<SlotList, NUM_LOUDNESS_LEVELS> byLoudness_;
+    std::size_t numLive_, numStolen_;
+
+    static std::uint8_t toLoudnessLevel(double loudness) {
+        if (loudness <= 0.0) {
+            return NUM_LOUDNESS_LEVELS - 1;
+        }
+        // [0.5, 1) -> 0, [0.25, 0.5) -> 1, ...
+        const int level = -std::ilogb(loudness) - 1;
+        return static_cast<std::uint8_t>(std::min<int>(std::max(level, 0), NUM_LOUDNESS_LEVELS - 1));
+    }
+
+    bool isLinked(std::size_t slot) const {
+        return ageLinks_.at(slot).linked;
+    }
+
+    void unlink(std::size_t slot) {
+        (released_.at(slot) ? releasedByAge_ : playing_).remove(ageLinks_, slot);
+        byLoudness_.at(loudness_.at(slot)).remove(loudnessLinks_, slot);
+        --numLive_;
+    }
+};
+}
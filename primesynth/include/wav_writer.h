@@ -0,0 +1,31 @@
+#pragma once
+#include "audio_sink.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace primesynth {
+// writes stereo WAV file
+class WAVWriter : public AudioSink {
+public:
+    WAVWriter(const std::string& filename, double sampleRate, SampleFormat format);
+    ~WAVWriter() override;
+
+    WAVWriter(const WAVWriter&) = delete;
+    WAVWriter& operator=(const WAVWriter&) = delete;
+
+    void write(const float* buffer, std::size_t numFrames) override;
+    // writes sizes into header, called by destructor if not called explicitly
+    void close() override;
+
+private:
+    std::ofstream ofs_;
+    const std::uint32_t sampleRate_;
+    const SampleFormat format_;
+    std::uint64_t numFrames_;
+    std::vector<char> converted_;
+
+    void writeHeader();
+};
+}
@@ -1,31 +1,42 @@
 #include "audio_output.h"
+#include <chrono>
+#include <functional>
 #include <sstream>
+#include <stdexcept>
+#ifdef _WIN32
 #define NOMINMAX
 #include <Windows.h>
+#endif
 
 namespace primesynth {
 int streamCallback(const void*, void* output, unsigned long frameCount, const PaStreamCallbackTimeInfo*,
                    PaStreamCallbackFlags, void* userData) {
     const auto out = static_cast<float*>(output);
-    const auto buffer = reinterpret_cast<RingBuffer*>(userData);
-    for (unsigned long i = 0; i < 2 * frameCount; ++i) {
-        out[i] = buffer->empty() ? 0 : buffer->shift();
-    }
+    const auto buffer = reinterpret_cast<RingBuffer<float>*>(userData);
+    // fill with silence on underrun
+    const std::size_t numRead = buffer->read(out, 2 * frameCount);
+    std::fill(out + numRead, out + 2 * frameCount, 0.0f);
+    return PaStreamCallbackResult::paContinue;
+}
+
+int renderCallback(const void*, void* output, unsigned long frameCount, const PaStreamCallbackTimeInfo*,
+                   PaStreamCallbackFlags, void* userData) {
+    const auto synth = static_cast<Synthesizer*>(userData);
+    synth->renderBlock(static_cast<float*>(output), frameCount);
     return PaStreamCallbackResult::paContinue;
 }
 
-void doRenderingLoop(std::atomic_bool& running, const Synthesizer& synth, RingBuffer& buffer, double sampleRate) {
+void doRenderingLoop(std::atomic_bool& running, Synthesizer& synth, RingBuffer<float>& buffer, double sampleRate) {
     static const int UNIT_STEPS = 64;
     const double stepDuration = UNIT_STEPS / sampleRate;
 
+    std::array<float, 2 * UNIT_STEPS> block;
     double aheadDuration = 0.0;
     auto lastTime = std::chrono::high_resolution_clock::now();
     while (running) {
-        for (int i = 0; i < UNIT_STEPS && !buffer.full(); ++i) {
-            const StereoValue sample = synth.render();
-            buffer.push(static_cast<float>(sample.left));
-            buffer.push(static_cast<float>(sample.right));
-        }
+        const std::size_t numFrames = std::min<std::size_t>(UNIT_STEPS, buffer.writable() / 2);
+        synth.renderBlock(block.data(), numFrames);
+        buffer.write(block.data(), 2 * numFrames);
 
         auto now = std::chrono::high_resolution_clock::now();
         aheadDuration += stepDuration - 2.0 * std::chrono::duration<double>(now - lastTime).count();
@@ -46,8 +57,23 @@ void checkPaError(PaError error) {
     }
 }
 
-AudioOutput::AudioOutput(Synthesizer& synth, std::size_t bufferSize, int deviceID, double sampleRate)
-    : buffer_(bufferSize), running_(true) {
+// PortAudio is initialized on first use so that rendering to other sinks works without audio devices
+void initPortAudio() {
+    static class PortAudioInstance {
+    public:
+        PortAudioInstance() {
+            checkPaError(Pa_Initialize());
+        }
+
+        ~PortAudioInstance() {
+            checkPaError(Pa_Terminate());
+        }
+    } instance;
+}
+
+AudioOutput::AudioOutput(Synthesizer& synth, std::size_t bufferSize, int deviceID, double sampleRate, bool pull)
+    : buffer_(pull ? 0 : bufferSize), running_(true) {
+    initPortAudio();
     PaStreamParameters params = {};
     params.channelCount = 2;
     params.sampleFormat = paFloat32;
@@ -64,15 +90,24 @@ AudioOutput::AudioOutput(Synthesizer& synth, std::size_t bufferSize, int deviceI
     const auto deviceInfo = Pa_GetDeviceInfo(params.device);
     params.suggestedLatency = deviceInfo->defaultLowOutputLatency;
 
+#ifdef _WIN32
     const UINT cp = GetConsoleCP();
     SetConsoleOutputCP(CP_UTF8);
+#endif
     printf("Audio: opening %s (%s, %.0fHz)\n", deviceInfo->name, Pa_GetHostApiInfo(deviceInfo->hostApi)->name,
            sampleRate);
+#ifdef _WIN32
     SetConsoleOutputCP(cp);
-    checkPaError(Pa_OpenStream(&stream_, nullptr, &params, sampleRate, paFramesPerBufferUnspecified, paNoFlag,
-                               streamCallback, &buffer_));
-
-    renderingThread = std::thread(doRenderingLoop, std::ref(running_), std::ref(synth), std::ref(buffer_), sampleRate);
+#endif
+    if (pull) {
+        checkPaError(Pa_OpenStream(&stream_, nullptr, &params, sampleRate, paFramesPerBufferUnspecified, paNoFlag,
+                                   renderCallback, &synth));
+    } else {
+        checkPaError(Pa_OpenStream(&stream_, nullptr, &params, sampleRate, paFramesPerBufferUnspecified, paNoFlag,
+                                   streamCallback, &buffer_));
+        renderingThread =
+            std::thread(doRenderingLoop, std::ref(running_), std::ref(synth), std::ref(buffer_), sampleRate);
+    }
 
     checkPaError(Pa_StartStream(stream_));
 }
@@ -87,21 +122,11 @@ AudioOutput::~AudioOutput() {
 }
 
 int AudioOutput::getDefaultDeviceID() {
+    initPortAudio();
     return Pa_GetDefaultOutputDevice();
 }
 
 double AudioOutput::getDefaultSampleRate() {
     return Pa_GetDeviceInfo(getDefaultDeviceID())->defaultSampleRate;
 }
-
-static class PortAudioInstance {
-public:
-    PortAudioInstance() {
-        checkPaError(Pa_Initialize());
-    }
-
-    ~PortAudioInstance() {
-        checkPaError(Pa_Terminate());
-    }
-} paInstance;
 }
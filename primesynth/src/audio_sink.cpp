@@ -0,0 +1,103 @@
+#include "audio_sink.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace primesynth {
+std::size_t getBytesPerSample(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::Int16:
+        return 2;
+    case SampleFormat::Int24:
+        return 3;
+    case SampleFormat::Float32:
+        return 4;
+    default:
+        throw std::runtime_error("unknown sample format");
+    }
+}
+
+float clampSample(float x) {
+    return std::min(std::max(x, -1.0f), 1.0f);
+}
+
+void convertSamples(const float* samples, std::size_t numSamples, SampleFormat format, char* out) {
+    switch (format) {
+    case SampleFormat::Int16:
+        for (std::size_t i = 0; i < numSamples; ++i) {
+            const auto s = static_cast<std::int16_t>(std::lround(clampSample(samples[i]) * 32767));
+            *out++ = static_cast<char>(s);
+            *out++ = static_cast<char>(s >> 8);
+        }
+        break;
+    case SampleFormat::Int24:
+        for (std::size_t i = 0; i < numSamples; ++i) {
+            const auto s = static_cast<std::int32_t>(std::lround(clampSample(samples[i]) * 8388607));
+            *out++ = static_cast<char>(s);
+            *out++ = static_cast<char>(s >> 8);
+            *out++ = static_cast<char>(s >> 16);
+        }
+        break;
+    case SampleFormat::Float32:
+        static_assert(std::numeric_limits<float>::is_iec559, "IEEE 754 float required");
+        // assuming little-endian host
+        std::memcpy(out, samples, numSamples * sizeof(float));
+        break;
+    default:
+        throw std::runtime_error("unknown sample format");
+    }
+}
+
+std::FILE* openRawOutput(const std::string& filename) {
+    if (filename == "-") {
+#ifdef _WIN32
+        // prevent newline translation
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        return stdout;
+    }
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("failed to open file");
+    }
+    return file;
+}
+
+RawSink::RawSink(const std::string& filename, SampleFormat format)
+    : file_(openRawOutput(filename)), ownsFile_(filename != "-"), format_(format) {}
+
+RawSink::~RawSink() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void RawSink::write(const float* buffer, std::size_t numFrames) {
+    const std::size_t numSamples = 2 * numFrames;
+    converted_.resize(numSamples * getBytesPerSample(format_));
+    convertSamples(buffer, numSamples, format_, converted_.data());
+    if (std::fwrite(converted_.data(), 1, converted_.size(), file_) != converted_.size()) {
+        throw std::runtime_error("failed to write raw audio");
+    }
+}
+
+void RawSink::close() {
+    if (!file_) {
+        return;
+    }
+    std::FILE* file = file_;
+    file_ = nullptr;
+    const bool failed = ownsFile_ ? std::fclose(file) != 0 : std::fflush(file) != 0;
+    if (failed) {
+        throw std::runtime_error("failed to write raw audio");
+    }
+}
+}
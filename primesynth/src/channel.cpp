@@ -1,8 +1,15 @@
 #include "channel.h"
+#include <stdexcept>
 
 namespace primesynth {
+static constexpr std::size_t MAX_VOICES = 256;
+// stolen voices fade out in this time (seconds) instead of stopping with a click
+static constexpr double STEAL_FADE_TIME = 0.005;
+
 Channel::Channel(double outputRate)
     : outputRate_(outputRate),
+      interpolation_(interp::Mode::Linear),
+      priority_(0),
       controllers_(),
       rpns_(),
       keyPressures_(),
@@ -12,13 +19,16 @@ Channel::Channel(double outputRate)
       pitchBendSensitivity_(2.0),
       fineTuning_(0.0),
       coarseTuning_(0.0),
-      currentNoteID_(0) {
+      voices_(MAX_VOICES, outputRate),
+      currentNoteID_(0),
+      controlPhase_(0),
+      channelPressureDirty_(false),
+      pitchBendDirty_(false) {
     controllers_.at(static_cast<std::size_t>(midi::ControlChange::Volume)) = 100;
     controllers_.at(static_cast<std::size_t>(midi::ControlChange::Pan)) = 64;
     controllers_.at(static_cast<std::size_t>(midi::ControlChange::Expression)) = 127;
     controllers_.at(static_cast<std::size_t>(midi::ControlChange::RPNLSB)) = 127;
     controllers_.at(static_cast<std::size_t>(midi::ControlChange::RPNMSB)) = 127;
-    voices_.reserve(128);
 }
 
 midi::Bank Channel::getBank() const {
@@ -30,13 +40,16 @@ bool Channel::hasPreset() const {
     return static_cast<bool>(preset_);
 }
 
+std::size_t Channel::getNumVoices() const {
+    return voices_.size();
+}
+
 void Channel::noteOff(std::uint8_t key) {
     const bool sustained = controllers_.at(static_cast<std::size_t>(midi::ControlChange::Sustain)) >= 64;
 
-    std::lock_guard<std::mutex> lockGuard(mutex_);
-    for (const auto& voice : voices_) {
-        if (voice->getActualKey() == key) {
-            voice->release(sustained);
+    for (auto& voice : voices_) {
+        if (voice.getActualKey() == key) {
+            releaseVoice(voice, sustained);
         }
     }
 }
@@ -47,29 +60,25 @@ void Channel::noteOn(std::uint8_t key, std::uint8_t velocity) {
         return;
     }
 
-    for (const Zone& presetZone : preset_->zones) {
-        if (presetZone.isInRange(key, velocity)) {
-            const std::int16_t instID = presetZone.generators.getOrDefault(sf::Generator::Instrument);
-            const auto& inst = preset_->soundFont.getInstruments().at(instID);
-            for (const Zone& instZone : inst.zones) {
-                if (instZone.isInRange(key, velocity)) {
-                    const std::int16_t sampleID = instZone.generators.getOrDefault(sf::Generator::SampleID);
-                    const auto& sample = preset_->soundFont.getSamples().at(sampleID);
-
-                    auto generators = instZone.generators;
-                    generators.add(presetZone.generators);
-
-                    auto modparams = instZone.modulatorParameters;
-                    modparams.mergeAndAdd(presetZone.modulatorParameters);
-                    modparams.merge(ModulatorParameterSet::getDefaultParameters());
-
-                    auto voice = std::make_unique<Voice>(currentNoteID_, outputRate_, sample, generators, modparams,
-                                                         key, velocity);
-                    voice->setPercussion(preset_->bank == PERCUSSION_BANK);
-                    addVoice(std::move(voice));
-                }
+    for (const std::size_t i : preset_->voiceTemplatesByKey.at(key)) {
+        const VoiceTemplate& voiceTemplate = preset_->voiceTemplates.at(i);
+        if (!voiceTemplate.velocityRange.contains(velocity)) {
+            continue;
+        }
+
+        std::size_t slot = voices_.acquire();
+        if (slot == VoicePool::npos) {
+            // polyphony does not bound voices of a channel while they fade out or have not been rendered yet
+            slot = voices_.reclaim();
+            if (slot == VoicePool::npos) {
+                break;
             }
         }
+
+        Voice& voice = voices_.construct(slot, currentNoteID_, outputRate_, *voiceTemplate.sample,
+                                         voiceTemplate.generators, voiceTemplate.modulators, key, velocity);
+        voice.setPercussion(preset_->bank == PERCUSSION_BANK);
+        addVoice(slot);
     }
     ++currentNoteID_;
 }
@@ -77,10 +86,9 @@ void Channel::noteOn(std::uint8_t key, std::uint8_t velocity) {
 void Channel::keyPressure(std::uint8_t key, std::uint8_t value) {
     keyPressures_.at(key) = value;
 
-    std::lock_guard<std::mutex> lockGuard(mutex_);
-    for (const auto& voice : voices_) {
-        if (voice->getActualKey() == key) {
-            voice->updateSFController(sf::GeneralController::PolyPressure, value);
+    for (auto& voice : voices_) {
+        if (voice.getActualKey() == key) {
+            voice.updateSFController(sf::GeneralController::PolyPressure, value);
         }
     }
 }
@@ -88,7 +96,6 @@ void Channel::keyPressure(std::uint8_t key, std::uint8_t value) {
 void Channel::controlChange(std::uint8_t controller, std::uint8_t value) {
     controllers_.at(controller) = value;
 
-    std::lock_guard<std::mutex> lockGuard(mutex_);
     switch (static_cast<midi::ControlChange>(controller)) {
     case midi::ControlChange::DataEntryMSB:
     case midi::ControlChange::DataEntryLSB:
@@ -105,9 +112,9 @@ void Channel::controlChange(std::uint8_t controller, std::uint8_t value) {
         break;
     case midi::ControlChange::Sustain:
         if (value < 64) {
-            for (const auto& voice : voices_) {
-                if (voice->getStatus() == Voice::State::Sustained) {
-                    voice->release(false);
+            for (auto& voice : voices_) {
+                if (voice.getStatus() == Voice::State::Sustained) {
+                    releaseVoice(voice, false);
                 }
             }
         }
@@ -147,10 +154,8 @@ void Channel::controlChange(std::uint8_t controller, std::uint8_t value) {
         keyPressures_ = {};
         channelPressure_ = 0;
         pitchBend_ = 1 << 13;
-        for (const auto& voice : voices_) {
-            voice->updateSFController(sf::GeneralController::ChannelPressure, channelPressure_);
-            voice->updateSFController(sf::GeneralController::PitchWheel, pitchBend_);
-        }
+        channelPressureDirty_ = true;
+        pitchBendDirty_ = true;
         for (std::uint8_t i = 1; i < 122; ++i) {
             if ((91 <= i && i <= 95) || (70 <= i && i <= 79)) {
                 continue;
@@ -165,15 +170,11 @@ void Channel::controlChange(std::uint8_t controller, std::uint8_t value) {
             case midi::ControlChange::RPNLSB:
             case midi::ControlChange::RPNMSB:
                 controllers_.at(i) = 127;
-                for (const auto& voice : voices_) {
-                    voice->updateMIDIController(i, 127);
-                }
+                dirtyControllers_.set(i);
                 break;
             default:
                 controllers_.at(i) = 0;
-                for (const auto& voice : voices_) {
-                    voice->updateMIDIController(i, 0);
-                }
+                dirtyControllers_.set(i);
                 break;
             }
         }
@@ -184,54 +185,101 @@ void Channel::controlChange(std::uint8_t controller, std::uint8_t value) {
 
         // All Notes Off is affected by CC 64 (Sustain)
         const bool sustained = controllers_.at(static_cast<std::size_t>(midi::ControlChange::Sustain)) >= 64;
-        for (const auto& voice : voices_) {
-            voice->release(sustained);
+        for (auto& voice : voices_) {
+            releaseVoice(voice, sustained);
         }
         break;
     }
     default:
-        for (const auto& voice : voices_) {
-            voice->updateMIDIController(controller, value);
-        }
+        dirtyControllers_.set(controller);
         break;
     }
 }
 
 void Channel::channelPressure(std::uint8_t value) {
     channelPressure_ = value;
-    std::lock_guard<std::mutex> lockGuard(mutex_);
-    for (const auto& voice : voices_) {
-        voice->updateSFController(sf::GeneralController::ChannelPressure, value);
-    }
+    channelPressureDirty_ = true;
 }
 
 void Channel::pitchBend(std::uint16_t value) {
     pitchBend_ = value;
-    std::lock_guard<std::mutex> lockGuard(mutex_);
-    for (const auto& voice : voices_) {
-        voice->updateSFController(sf::GeneralController::PitchWheel, value);
-    }
+    pitchBendDirty_ = true;
 }
 
 void Channel::setPreset(const std::shared_ptr<const Preset>& preset) {
     preset_ = preset;
 }
 
-StereoValue Channel::render() {
-    StereoValue sum{0.0, 0.0};
-    std::lock_guard<std::mutex> lockGuard(mutex_);
-    for (const auto& voice : voices_) {
-        if (voice->getStatus() == Voice::State::Finished) {
-            continue;
-        }
-        voice->update();
+void Channel::setInterpolation(interp::Mode interpolation) {
+    interpolation_ = interpolation;
+}
 
-        if (voice->getStatus() == Voice::State::Finished) {
-            continue;
+void Channel::setCalcInterval(unsigned int interval) {
+    voices_.setCalcInterval(interval);
+    controlPhase_ = 0;
+}
+
+void Channel::setPriority(int priority) {
+    priority_ = priority;
+}
+
+bool Channel::findVictim(StealingPolicy policy, VictimRank& rank) {
+    const std::size_t slot = voices_.findVictim(policy);
+    if (slot == VoicePool::npos) {
+        return false;
+    }
+
+    const Voice& voice = voices_.at(slot);
+    const bool released = voices_.isReleased(slot);
+    const unsigned int age = released ? voice.getReleaseAge() : voice.getAge();
+    switch (policy) {
+    case StealingPolicy::OldestReleased:
+        rank = {0, released, age};
+        break;
+    case StealingPolicy::Quietest:
+        rank = {0, voices_.getLoudnessLevel(slot), voice.getAge()};
+        break;
+    case StealingPolicy::LowestPriority:
+        rank = {-priority_, released, age};
+        break;
+    default:
+        throw std::runtime_error("unknown voice stealing policy");
+    }
+    return true;
+}
+
+bool Channel::stealVoice(StealingPolicy policy) {
+    const std::size_t slot = voices_.findVictim(policy);
+    if (slot == VoicePool::npos) {
+        return false;
+    }
+    voices_.steal(slot, static_cast<std::size_t>(STEAL_FADE_TIME * outputRate_));
+    return true;
+}
+
+void Channel::render(float* left, float* right, std::size_t numFrames) {
+    applyDirtyControllers();
+
+    renderVoices(left, right, numFrames);
+
+    for (auto& voice : voices_) {
+        voices_.updateLoudness(voice);
+    }
+    voices_.removeFinished();
+}
+
+// renders in pieces between ticks of control grid
+void Channel::renderVoices(float* left, float* right, std::size_t numFrames) {
+    const unsigned int interval = voices_.getCalcInterval();
+    for (std::size_t offset = 0; offset < numFrames;) {
+        voices_.updateControl(controlPhase_);
+        const std::size_t n = std::min<std::size_t>(numFrames - offset, interval - controlPhase_);
+        for (auto& voice : voices_) {
+            voice.render(left + offset, right + offset, n, interpolation_);
         }
-        sum += voice->render();
+        offset += n;
+        controlPhase_ = (controlPhase_ + n) % interval;
     }
-    return sum;
 }
 
 std::uint16_t Channel::getSelectedRPN() const {
@@ -239,35 +287,55 @@ std::uint16_t Channel::getSelectedRPN() const {
                            controllers_.at(static_cast<std::size_t>(midi::ControlChange::RPNLSB)));
 }
 
-void Channel::addVoice(std::unique_ptr<Voice> voice) {
-    voice->updateSFController(sf::GeneralController::PolyPressure, keyPressures_.at(voice->getActualKey()));
-    voice->updateSFController(sf::GeneralController::ChannelPressure, channelPressure_);
-    voice->updateSFController(sf::GeneralController::PitchWheel, pitchBend_);
-    voice->updateSFController(sf::GeneralController::PitchWheelSensitivity, pitchBendSensitivity_);
-    voice->updateFineTuning(fineTuning_);
-    voice->updateCoarseTuning(coarseTuning_);
-    for (std::uint8_t i = 0; i < midi::NUM_CONTROLLERS; ++i) {
-        voice->updateMIDIController(i, controllers_.at(i));
-    }
+void Channel::addVoice(std::size_t slot) {
+    Voice& voice = voices_.at(slot);
+    voice.updateSFController(sf::GeneralController::PolyPressure, keyPressures_.at(voice.getActualKey()));
+    voice.updateSFController(sf::GeneralController::ChannelPressure, channelPressure_);
+    voice.updateSFController(sf::GeneralController::PitchWheel, pitchBend_);
+    voice.updateSFController(sf::GeneralController::PitchWheelSensitivity, pitchBendSensitivity_);
+    voice.updateFineTuning(fineTuning_);
+    voice.updateCoarseTuning(coarseTuning_);
+    voice.updateMIDIControllers(controllers_);
 
-    const auto exclusiveClass = voice->getExclusiveClass();
+    const auto exclusiveClass = voice.getExclusiveClass();
 
-    std::lock_guard<std::mutex> lockGuard(mutex_);
     if (exclusiveClass != 0) {
-        for (const auto& v : voices_) {
-            if (v->getNoteID() != currentNoteID_ && v->getExclusiveClass() == exclusiveClass) {
-                v->release(false);
+        for (auto& v : voices_) {
+            if (v.getNoteID() != currentNoteID_ && v.getExclusiveClass() == exclusiveClass) {
+                releaseVoice(v, false);
             }
         }
     }
+    voices_.activate(slot);
+}
 
-    for (auto& v : voices_) {
-        if (v->getStatus() == Voice::State::Finished) {
-            v = std::move(voice);
-            return;
+void Channel::releaseVoice(Voice& voice, bool sustained) {
+    voice.release(sustained);
+    voices_.notifyReleased(voice);
+}
+
+void Channel::applyDirtyControllers() {
+    if (!channelPressureDirty_ && !pitchBendDirty_ && dirtyControllers_.none()) {
+        return;
+    }
+
+    // voices added since the changes already have latest values, which are harmlessly applied again
+    for (auto& voice : voices_) {
+        if (channelPressureDirty_) {
+            voice.updateSFController(sf::GeneralController::ChannelPressure, channelPressure_);
+        }
+        if (pitchBendDirty_) {
+            voice.updateSFController(sf::GeneralController::PitchWheel, pitchBend_);
+        }
+        for (std::size_t i = 0; i < midi::NUM_CONTROLLERS; ++i) {
+            if (dirtyControllers_.test(i)) {
+                voice.updateMIDIController(static_cast<std::uint8_t>(i), controllers_.at(i));
+            }
         }
     }
-    voices_.emplace_back(std::move(voice));
+    channelPressureDirty_ = false;
+    pitchBendDirty_ = false;
+    dirtyControllers_.reset();
 }
 
 void Channel::updateRPN() {
@@ -276,24 +344,26 @@ void Channel::updateRPN() {
     switch (static_cast<midi::RPN>(rpn)) {
     case midi::RPN::PitchBendSensitivity:
         pitchBendSensitivity_ = data / 128.0;
-        for (const auto& voice : voices_) {
-            voice->updateSFController(sf::GeneralController::PitchWheelSensitivity, pitchBendSensitivity_);
+        for (auto& voice : voices_) {
+            voice.updateSFController(sf::GeneralController::PitchWheelSensitivity, pitchBendSensitivity_);
         }
         break;
     case midi::RPN::FineTuning: {
         fineTuning_ = (data - 8192) / 81.92;
-        for (const auto& voice : voices_) {
-            voice->updateFineTuning(fineTuning_);
+        for (auto& voice : voices_) {
+            voice.updateFineTuning(fineTuning_);
         }
         break;
     }
     case midi::RPN::CoarseTuning: {
         coarseTuning_ = (data - 8192) / 128.0;
-        for (const auto& voice : voices_) {
-            voice->updateCoarseTuning(coarseTuning_);
+        for (auto& voice : voices_) {
+            voice.updateCoarseTuning(coarseTuning_);
         }
         break;
     }
+    default:
+        break;
     }
 }
 }
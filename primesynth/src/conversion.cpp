@@ -1,34 +1,76 @@
 #include "conversion.h"
-#include <array>
+#include <cmath>
 
 namespace primesynth {
 namespace conv {
-std::array<double, 1441> attenToAmpTable;
-std::array<double, 1200> centToHertzTable;
+static constexpr double LN_2 = 0.6931471805599453;
+static constexpr double LOG2_10 = 3.321928094887362;
+// attenuation at which amplitude is regarded as 0
+static constexpr std::size_t MAX_ATTEN = 1440;
+static constexpr std::size_t CENTS_PER_OCTAVE = 1200;
 
-void initialize() {
-    static bool initialized = false;
-    if (!initialized) {
-        initialized = true;
+// std::exp2 is not constexpr
+constexpr double constexprExp2(double x) {
+    // split into integer and fractional parts so that series of e^y converges quickly
+    int n = static_cast<int>(x);
+    if (x < n) {
+        --n;
+    }
+    const double y = (x - n) * LN_2;
+    double term = 1.0;
+    double sum = 1.0;
+    for (int k = 1; k < 20; ++k) {
+        term *= y / k;
+        sum += term;
+    }
+    for (; n > 0; --n) {
+        sum *= 2.0;
+    }
+    for (; n < 0; ++n) {
+        sum *= 0.5;
+    }
+    return sum;
+}
+
+template <std::size_t Size>
+struct Table {
+    double values[Size];
+
+    // linear interpolation between i-th and (i + 1)-th values
+    double interpolate(std::size_t i, double fraction) const {
+        return values[i] + fraction * (values[i + 1] - values[i]);
+    }
+};
 
-        for (std::size_t i = 0; i < attenToAmpTable.size(); ++i) {
-            // -200 instead of -100 for compatibility
-            attenToAmpTable.at(i) = std::pow(10.0, i / -200.0);
-        }
-        for (std::size_t i = 0; i < centToHertzTable.size(); i++) {
-            centToHertzTable.at(i) = 6.875 * std::exp2(i / 1200.0);
-        }
+// last entries are only read as upper neighbors in interpolation
+constexpr Table<MAX_ATTEN + 1> makeAttenToAmpTable() {
+    Table<MAX_ATTEN + 1> table{};
+    for (std::size_t i = 0; i <= MAX_ATTEN; ++i) {
+        // -200 instead of -100 for compatibility
+        table.values[i] = constexprExp2(i / -200.0 * LOG2_10);
     }
+    return table;
 }
 
+constexpr Table<CENTS_PER_OCTAVE + 1> makeCentToHertzTable() {
+    Table<CENTS_PER_OCTAVE + 1> table{};
+    for (std::size_t i = 0; i <= CENTS_PER_OCTAVE; ++i) {
+        table.values[i] = 6.875 * constexprExp2(static_cast<double>(i) / CENTS_PER_OCTAVE);
+    }
+    return table;
+}
+
+static constexpr auto ATTEN_TO_AMP_TABLE = makeAttenToAmpTable();
+static constexpr auto CENT_TO_HERTZ_TABLE = makeCentToHertzTable();
+
 double attenuationToAmplitude(double atten) {
     if (atten <= 0.0) {
         return 1.0;
-    } else if (atten >= attenToAmpTable.size()) {
+    } else if (atten >= MAX_ATTEN) {
         return 0.0;
-    } else {
-        return attenToAmpTable.at(static_cast<std::size_t>(atten));
     }
+    const auto i = static_cast<std::size_t>(atten);
+    return ATTEN_TO_AMP_TABLE.interpolate(i, atten - i);
 }
 
 double amplitudeToAttenuation(double amp) {
@@ -36,21 +78,16 @@ double amplitudeToAttenuation(double amp) {
 }
 
 double keyToHertz(double key) {
-    if (key < 0.0) {
+    if (key < 0.0 || key >= 141.0) {
         return 1.0;
     }
 
-    int offset = 300;
-    int ratio = 1;
-    for (int threshold = 900; threshold <= 14100; threshold += 1200) {
-        if (key * 100.0 < threshold) {
-            return ratio * centToHertzTable.at(static_cast<int>(key * 100.0) + offset);
-        }
-        offset -= 1200;
-        ratio *= 2;
-    }
-
-    return 1.0;
+    // 6.875 Hz is 300 cents below key 0
+    const double cents = 100.0 * key + 300.0;
+    const auto wholeCents = static_cast<std::size_t>(cents);
+    const std::size_t octave = wholeCents / CENTS_PER_OCTAVE;
+    const std::size_t i = wholeCents - CENTS_PER_OCTAVE * octave;
+    return (1 << octave) * CENT_TO_HERTZ_TABLE.interpolate(i, cents - wholeCents);
 }
 
 double timecentToSecond(double tc) {
@@ -1,82 +1,109 @@
 #include "conversion.h"
 #include "envelope.h"
+#include <stdexcept>
 
 namespace primesynth {
-Envelope::Envelope(double outputRate, unsigned int interval)
-    : effectiveOutputRate_(outputRate / interval), params_(), phase_(Phase::Delay), phaseSteps_(0), value_(1.0) {}
+EnvelopeBank::EnvelopeBank(std::size_t size, double outputRate, unsigned int interval)
+    : outputRate_(outputRate),
+      effectiveOutputRate_(outputRate / interval),
+      phases_(size, Phase::Finished),
+      phaseSteps_(size, 0.0),
+      values_(size, 0.0) {
+    for (auto& params : params_) {
+        params.assign(size, 0.0);
+    }
+}
+
+void EnvelopeBank::setInterval(unsigned int interval) {
+    effectiveOutputRate_ = outputRate_ / interval;
+}
+
+EnvelopeBank::Phase EnvelopeBank::getPhase(std::size_t i) const {
+    return phases_[i];
+}
 
-Envelope::Phase Envelope::getPhase() const {
-    return phase_;
+double EnvelopeBank::getValue(std::size_t i) const {
+    return values_[i];
 }
 
-double Envelope::getValue() const {
-    return value_;
+void EnvelopeBank::reset(std::size_t i) {
+    for (auto& params : params_) {
+        params[i] = 0.0;
+    }
+    changePhase(i, Phase::Delay);
+    values_[i] = 1.0;
 }
 
-void Envelope::setParameter(Phase phase, double param) {
+void EnvelopeBank::setParameter(std::size_t i, Phase phase, double param) {
     if (phase == Phase::Sustain) {
-        params_.at(static_cast<std::size_t>(Phase::Sustain)) = 1.0 - 0.001 * param;
+        params_[static_cast<std::size_t>(Phase::Sustain)][i] = 1.0 - 0.001 * param;
     } else if (phase < Phase::Finished) {
-        params_.at(static_cast<std::size_t>(phase)) = effectiveOutputRate_ * conv::timecentToSecond(param);
+        params_[static_cast<std::size_t>(phase)][i] = effectiveOutputRate_ * conv::timecentToSecond(param);
     } else {
         throw std::invalid_argument("unknown phase");
     }
 }
 
-void Envelope::release() {
-    if (phase_ < Phase::Release) {
-        changePhase(Phase::Release);
+void EnvelopeBank::release(std::size_t i) {
+    if (phases_[i] < Phase::Release) {
+        changePhase(i, Phase::Release);
     }
 }
 
-void Envelope::update() {
-    if (phase_ == Phase::Finished) {
-        return;
-    }
+void EnvelopeBank::update(std::size_t begin, std::size_t end, double step) {
+    const std::vector<double>& sustains = params_[static_cast<std::size_t>(Phase::Sustain)];
 
-    ++phaseSteps_;
+    for (std::size_t i = begin; i < end; ++i) {
+        Phase& phase = phases_[i];
+        if (phase == Phase::Finished) {
+            continue;
+        }
 
-    auto i = static_cast<std::size_t>(phase_);
-    while (phase_ < Phase::Finished && phase_ != Phase::Sustain && phaseSteps_ >= params_.at(i)) {
-        changePhase(static_cast<Phase>(++i));
-    }
+        phaseSteps_[i] += step;
 
-    const double& sustain = params_.at(static_cast<std::size_t>(Phase::Sustain));
-    switch (phase_) {
-    case Phase::Delay:
-    case Phase::Finished:
-        value_ = 0.0;
-        return;
-    case Phase::Attack:
-        value_ = phaseSteps_ / params_.at(i);
-        return;
-    case Phase::Hold:
-        value_ = 1.0;
-        return;
-    case Phase::Decay:
-        value_ = 1.0 - phaseSteps_ / params_.at(i);
-        if (value_ <= sustain) {
-            value_ = sustain;
-            changePhase(Phase::Sustain);
+        // phase changes happen rarely, so this loop is mostly skipped
+        auto p = static_cast<std::size_t>(phase);
+        while (phase < Phase::Finished && phase != Phase::Sustain && phaseSteps_[i] >= params_[p][i]) {
+            changePhase(i, static_cast<Phase>(++p));
         }
-        return;
-    case Phase::Sustain:
-        value_ = sustain;
-        return;
-    case Phase::Release:
-        value_ -= 1.0 / params_.at(i);
-        if (value_ <= 0.0) {
-            value_ = 0.0;
-            changePhase(Phase::Finished);
+
+        double& value = values_[i];
+        switch (phase) {
+        case Phase::Delay:
+        case Phase::Finished:
+            value = 0.0;
+            break;
+        case Phase::Attack:
+            value = phaseSteps_[i] / params_[p][i];
+            break;
+        case Phase::Hold:
+            value = 1.0;
+            break;
+        case Phase::Decay:
+            value = 1.0 - phaseSteps_[i] / params_[p][i];
+            if (value <= sustains[i]) {
+                value = sustains[i];
+                changePhase(i, Phase::Sustain);
+            }
+            break;
+        case Phase::Sustain:
+            value = sustains[i];
+            break;
+        case Phase::Release:
+            value -= step / params_[p][i];
+            if (value <= 0.0) {
+                value = 0.0;
+                changePhase(i, Phase::Finished);
+            }
+            break;
+        default:
+            throw std::logic_error("unreachable");
         }
-        return;
     }
-
-    throw std::logic_error("unreachable");
 }
 
-void Envelope::changePhase(Phase phase) {
-    phase_ = phase;
-    phaseSteps_ = 0;
+void EnvelopeBank::changePhase(std::size_t i, Phase phase) {
+    phases_[i] = phase;
+    phaseSteps_[i] = 0.0;
 }
 }
@@ -0,0 +1,314 @@
+#include "interpolation.h"
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(PRIMESYNTH_NO_SIMD)
+#if defined(__AVX2__)
+#define PRIMESYNTH_AVX2
+#define PRIMESYNTH_SSE2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PRIMESYNTH_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace primesynth {
+namespace interp {
+// only upper 24 bits of fractions fit in mantissa of float
+static constexpr float FRACTION_SCALE = 1.0f / (1 << 24);
+static constexpr float SAMPLE_SCALE = 1.0f / INT16_MAX;
+
+// coefficient tables are indexed by upper bits of fractions
+static constexpr int PHASE_BITS = 8;
+static constexpr std::size_t NUM_PHASES = 1 << PHASE_BITS;
+
+template <std::size_t NumPoints>
+struct CoefficientTable {
+    alignas(16) float coefs[NUM_PHASES][NumPoints];
+
+    const float* operator[](std::uint32_t fraction) const {
+        return coefs[fraction >> (32 - PHASE_BITS)];
+    }
+};
+
+const CoefficientTable<4>& getCubicTable() {
+    static const auto table = [] {
+        CoefficientTable<4> t;
+        for (std::size_t i = 0; i < NUM_PHASES; ++i) {
+            const double x = static_cast<double>(i) / NUM_PHASES;
+            t.coefs[i][0] = static_cast<float>(0.5 * (-x * x * x + 2.0 * x * x - x));
+            t.coefs[i][1] = static_cast<float>(0.5 * (3.0 * x * x * x - 5.0 * x * x + 2.0));
+            t.coefs[i][2] = static_cast<float>(0.5 * (-3.0 * x * x * x + 4.0 * x * x + x));
+            t.coefs[i][3] = static_cast<float>(0.5 * (x * x * x - x * x));
+        }
+        return t;
+    }();
+    return table;
+}
+
+static constexpr std::size_t SINC_POINTS = 8;
+
+const CoefficientTable<SINC_POINTS>& getSincTable() {
+    static const auto table = [] {
+        static constexpr double PI = 3.141592653589793;
+        static constexpr double HALF_WIDTH = SINC_POINTS / 2;
+        CoefficientTable<SINC_POINTS> t;
+        for (std::size_t i = 0; i < NUM_PHASES; ++i) {
+            const double x = static_cast<double>(i) / NUM_PHASES;
+            double sum = 0.0;
+            std::array<double, SINC_POINTS> c;
+            for (std::size_t j = 0; j < SINC_POINTS; ++j) {
+                // distance from interpolated position to j-th point
+                const double d = static_cast<double>(j) - (HALF_WIDTH - 1.0) - x;
+                const double sinc = d == 0.0 ? 1.0 : std::sin(PI * d) / (PI * d);
+                const double window =
+                    0.42 + 0.5 * std::cos(PI * d / HALF_WIDTH) + 0.08 * std::cos(2.0 * PI * d / HALF_WIDTH);
+                c.at(j) = sinc * window;
+                sum += c.at(j);
+            }
+            // normalize so that DC gain is 1
+            for (std::size_t j = 0; j < SINC_POINTS; ++j) {
+                t.coefs[i][j] = static_cast<float>(c.at(j) / sum);
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+#if defined(PRIMESYNTH_SSE2)
+// converts 4 16-bit integers in lower half of x to floats
+__m128 convertLower4(__m128i x) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+}
+
+__m128 convertUpper4(__m128i x) {
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+}
+
+// returns {sum(a), sum(b), sum(c), sum(d)}
+__m128 horizontalSum4(__m128 a, __m128 b, __m128 c, __m128 d) {
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    return _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d));
+}
+#endif
+
+// each interpolator reads points in [index - LEFT, index + RIGHT]
+
+struct NearestInterpolator {
+    static constexpr std::size_t LEFT = 0, RIGHT = 1;
+
+    static float interpolate(const std::int16_t* p, std::uint32_t fraction) {
+        return p[fraction >> 31];
+    }
+
+#if defined(PRIMESYNTH_SSE2)
+    static __m128 interpolate4(const std::int16_t* data, const std::uint32_t* indices, const std::uint32_t* fractions) {
+        return _mm_setr_ps(interpolate(data + indices[0], fractions[0]), interpolate(data + indices[1], fractions[1]),
+                           interpolate(data + indices[2], fractions[2]), interpolate(data + indices[3], fractions[3]));
+    }
+#endif
+};
+
+struct LinearInterpolator {
+    static constexpr std::size_t LEFT = 0, RIGHT = 1;
+
+    static float interpolate(const std::int16_t* p, std::uint32_t fraction) {
+        const float r = static_cast<float>(fraction >> 8) * FRACTION_SCALE;
+        return p[0] + r * (p[1] - p[0]);
+    }
+
+#if defined(PRIMESYNTH_SSE2)
+    static __m128 interpolate4(const std::int16_t* data, const std::uint32_t* indices, const std::uint32_t* fractions) {
+        // load pairs of adjacent 16-bit samples as 32-bit integers
+        std::int32_t p[4];
+        for (int j = 0; j < 4; ++j) {
+            std::memcpy(&p[j], data + indices[j], sizeof(std::int32_t));
+        }
+        const __m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128 s0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16));
+        const __m128 s1 = _mm_cvtepi32_ps(_mm_srai_epi32(pairs, 16));
+
+        const __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fractions));
+        const __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(f, 8)), _mm_set1_ps(FRACTION_SCALE));
+        return _mm_add_ps(s0, _mm_mul_ps(r, _mm_sub_ps(s1, s0)));
+    }
+#endif
+
+#if defined(PRIMESYNTH_AVX2)
+    static __m256 interpolate8(const std::int16_t* data, const std::uint32_t* indices, const std::uint32_t* fractions) {
+        // each 32-bit gather loads a pair of adjacent 16-bit samples
+        const __m256i i = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+        const __m256i pairs = _mm256_i32gather_epi32(reinterpret_cast<const int*>(data), i, 2);
+        const __m256 s0 = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pairs, 16), 16));
+        const __m256 s1 = _mm256_cvtepi32_ps(_mm256_srai_epi32(pairs, 16));
+
+        const __m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(fractions));
+        const __m256 r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(f, 8)), _mm256_set1_ps(FRACTION_SCALE));
+        return _mm256_add_ps(s0, _mm256_mul_ps(r, _mm256_sub_ps(s1, s0)));
+    }
+#endif
+};
+
+struct CubicInterpolator {
+    static constexpr std::size_t LEFT = 1, RIGHT = 2;
+
+    static float interpolate(const std::int16_t* p, std::uint32_t fraction) {
+        const float* c = getCubicTable()[fraction];
+        return c[0] * p[-1] + c[1] * p[0] + c[2] * p[1] + c[3] * p[2];
+    }
+
+#if defined(PRIMESYNTH_SSE2)
+    static __m128 interpolate4(const std::int16_t* data, const std::uint32_t* indices, const std::uint32_t* fractions) {
+        const auto& table = getCubicTable();
+        __m128 products[4];
+        for (int j = 0; j < 4; ++j) {
+            const __m128i points = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data + indices[j] - LEFT));
+            products[j] = _mm_mul_ps(convertLower4(points), _mm_load_ps(table[fractions[j]]));
+        }
+        return horizontalSum4(products[0], products[1], products[2], products[3]);
+    }
+#endif
+};
+
+struct SincInterpolator {
+    static constexpr std::size_t LEFT = SINC_POINTS / 2 - 1, RIGHT = SINC_POINTS / 2;
+
+    static float interpolate(const std::int16_t* p, std::uint32_t fraction) {
+        const float* c = getSincTable()[fraction];
+        const std::int16_t* points = p - LEFT;
+        float sum = 0.0f;
+        for (std::size_t j = 0; j < SINC_POINTS; ++j) {
+            sum += c[j] * points[j];
+        }
+        return sum;
+    }
+
+#if defined(PRIMESYNTH_SSE2)
+    static __m128 interpolate4(const std::int16_t* data, const std::uint32_t* indices, const std::uint32_t* fractions) {
+        static_assert(SINC_POINTS == 8, "SIMD kernel assumes 8 points");
+        const auto& table = getSincTable();
+        __m128 products[4];
+        for (int j = 0; j < 4; ++j) {
+            const __m128i points = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + indices[j] - LEFT));
+            const float* c = table[fractions[j]];
+            products[j] = _mm_add_ps(_mm_mul_ps(convertLower4(points), _mm_load_ps(c)),
+                                     _mm_mul_ps(convertUpper4(points), _mm_load_ps(c + 4)));
+        }
+        return horizontalSum4(products[0], products[1], products[2], products[3]);
+    }
+#endif
+};
+
+#if defined(PRIMESYNTH_AVX2)
+template <class Interpolator>
+__m256 interpolate8(const std::int16_t* data, const std::uint32_t* indices, const std::uint32_t* fractions) {
+    const __m128 lo = Interpolator::interpolate4(data, indices, fractions);
+    const __m128 hi = Interpolator::interpolate4(data, indices + 4, fractions + 4);
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+template <>
+__m256 interpolate8<LinearInterpolator>(const std::int16_t* data, const std::uint32_t* indices,
+                                        const std::uint32_t* fractions) {
+    return LinearInterpolator::interpolate8(data, indices, fractions);
+}
+#endif
+
+template <class Interpolator>
+class Renderer {
+public:
+    static_assert(Interpolator::LEFT <= GUARD_POINTS && Interpolator::RIGHT <= GUARD_POINTS,
+                  "interpolator reads beyond guard points");
+
+    Renderer(const std::int16_t* samples, const Positions& positions, const Gain& gain, float* left, float* right)
+        : samples_(samples), positions_(positions), gain_(gain), left_(left), right_(right) {}
+
+    void render(std::size_t numFrames) {
+        std::size_t i = 0;
+#if defined(PRIMESYNTH_AVX2)
+        for (; i + 8 <= numFrames; i += 8) {
+            accumulate8(i, interpolate8<Interpolator>(samples_, positions_.indices + i, positions_.fractions + i));
+        }
+#endif
+#if defined(PRIMESYNTH_SSE2)
+        for (; i + 4 <= numFrames; i += 4) {
+            accumulate4(i, Interpolator::interpolate4(samples_, positions_.indices + i, positions_.fractions + i));
+        }
+#endif
+        renderScalar(i, numFrames);
+    }
+
+private:
+    const std::int16_t* const samples_;
+    const Positions& positions_;
+    const Gain& gain_;
+    float* const left_;
+    float* const right_;
+
+    void renderScalar(std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const float interpolated =
+                Interpolator::interpolate(samples_ + positions_.indices[i], positions_.fractions[i]);
+            const float sample = (gain_.amp + i * gain_.deltaAmp) * SAMPLE_SCALE * interpolated;
+            left_[i] += gain_.left * sample;
+            right_[i] += gain_.right * sample;
+        }
+    }
+
+#if defined(PRIMESYNTH_SSE2)
+    void accumulate4(std::size_t i, __m128 interpolated) {
+        const __m128 steps = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        const __m128 amp =
+            _mm_add_ps(_mm_set1_ps(gain_.amp + i * gain_.deltaAmp), _mm_mul_ps(steps, _mm_set1_ps(gain_.deltaAmp)));
+        const __m128 sample = _mm_mul_ps(amp, interpolated);
+        const __m128 volumeLeft = _mm_set1_ps(gain_.left * SAMPLE_SCALE);
+        const __m128 volumeRight = _mm_set1_ps(gain_.right * SAMPLE_SCALE);
+        _mm_storeu_ps(left_ + i, _mm_add_ps(_mm_loadu_ps(left_ + i), _mm_mul_ps(volumeLeft, sample)));
+        _mm_storeu_ps(right_ + i, _mm_add_ps(_mm_loadu_ps(right_ + i), _mm_mul_ps(volumeRight, sample)));
+    }
+#endif
+
+#if defined(PRIMESYNTH_AVX2)
+    void accumulate8(std::size_t i, __m256 interpolated) {
+        const __m256 steps = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        const __m256 amp = _mm256_add_ps(_mm256_set1_ps(gain_.amp + i * gain_.deltaAmp),
+                                         _mm256_mul_ps(steps, _mm256_set1_ps(gain_.deltaAmp)));
+        const __m256 sample = _mm256_mul_ps(amp, interpolated);
+        const __m256 volumeLeft = _mm256_set1_ps(gain_.left * SAMPLE_SCALE);
+        const __m256 volumeRight = _mm256_set1_ps(gain_.right * SAMPLE_SCALE);
+        _mm256_storeu_ps(left_ + i, _mm256_add_ps(_mm256_loadu_ps(left_ + i), _mm256_mul_ps(volumeLeft, sample)));
+        _mm256_storeu_ps(right_ + i, _mm256_add_ps(_mm256_loadu_ps(right_ + i), _mm256_mul_ps(volumeRight, sample)));
+    }
+#endif
+};
+
+template <class Interpolator>
+void render(const std::int16_t* samples, const Positions& positions, std::size_t numFrames, const Gain& gain,
+            float* left, float* right) {
+    Renderer<Interpolator>(samples, positions, gain, left, right).render(numFrames);
+}
+
+void render(Mode mode, const std::int16_t* samples, const Positions& positions, std::size_t numFrames,
+            const Gain& gain, float* left, float* right) {
+    switch (mode) {
+    case Mode::None:
+        render<NearestInterpolator>(samples, positions, numFrames, gain, left, right);
+        return;
+    case Mode::Linear:
+        render<LinearInterpolator>(samples, positions, numFrames, gain, left, right);
+        return;
+    case Mode::Cubic:
+        render<CubicInterpolator>(samples, positions, numFrames, gain, left, right);
+        return;
+    case Mode::Sinc:
+        render<SincInterpolator>(samples, positions, numFrames, gain, left, right);
+        return;
+    }
+    throw std::invalid_argument("unknown interpolation mode");
+}
+}
+}
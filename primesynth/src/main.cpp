@@ -1,7 +1,144 @@
-#include "audio_output.h"
-#include "midi_input.h"
+#include "audio_sink.h"
+#include "midi_file.h"
+#include "midi_stream_input.h"
 #include "synthesizer.h"
 #include "third_party/cmdline.h"
+#include "wav_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#ifndef PRIMESYNTH_NO_PORTAUDIO
+#include "audio_output.h"
+#endif
+#ifdef _WIN32
+#include "midi_input.h"
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+// render until silence after end of input, but no longer than this
+static constexpr double MAX_TAIL_DURATION = 10.0;
+
+bool isSilent(const std::vector<float>& buffer, std::size_t numFrames) {
+    static constexpr float SILENCE_THRESHOLD = 1e-5f;
+    return std::all_of(buffer.begin(), buffer.begin() + 2 * numFrames,
+                       [](float x) { return std::abs(x) < SILENCE_THRESHOLD; });
+}
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void handleInterrupt(int) {
+    interrupted = 1;
+}
+
+std::unique_ptr<primesynth::AudioSink> createSink(const std::string& type, const std::string& filename,
+                                                  double sampleRate, primesynth::SampleFormat format) {
+    using namespace primesynth;
+    if (type == "wav") {
+        return std::make_unique<WAVWriter>(filename, sampleRate, format);
+    } else if (type == "raw") {
+        return std::make_unique<RawSink>(filename, format);
+    }
+    return std::make_unique<NullSink>();
+}
+
+// renders MIDI file as fast as possible, returns duration of rendered audio in seconds
+double renderMIDIFile(primesynth::Synthesizer& synth, const primesynth::MIDIFile& midiFile,
+                      primesynth::AudioSink& sink) {
+    static constexpr std::size_t BLOCK_SIZE = 1024;
+
+    const double sampleRate = synth.getSampleRate();
+    const auto endFrame = static_cast<std::uint64_t>(std::ceil(midiFile.getLength() * sampleRate));
+    const auto maxFrame = endFrame + static_cast<std::uint64_t>(MAX_TAIL_DURATION * sampleRate);
+    const auto& events = midiFile.getEvents();
+
+    std::vector<float> buffer(2 * BLOCK_SIZE);
+    std::size_t e = 0;
+    std::uint64_t frame = 0;
+    while (frame < maxFrame) {
+        std::size_t numFrames = static_cast<std::size_t>(std::min<std::uint64_t>(BLOCK_SIZE, maxFrame - frame));
+        for (; e < events.size(); ++e) {
+            const auto eventFrame = static_cast<std::uint64_t>(std::llround(events[e].time * sampleRate));
+            if (eventFrame >= frame + numFrames) {
+                break;
+            }
+            if (events[e].sysEx.size() > primesynth::MIDIEvent::MAX_SYSEX_LENGTH) {
+                // rejected by the synthesizer, which does not respond to it anyway
+                continue;
+            }
+            const bool queued = events[e].sysEx.empty()
+                                    ? synth.processShortMessage(events[e].param, eventFrame)
+                                    : synth.processSysEx(events[e].sysEx.data(), events[e].sysEx.size(), eventFrame);
+            if (!queued) {
+                // event queue is full, render queued events first
+                if (eventFrame == frame) {
+                    throw std::runtime_error("too many simultaneous MIDI events");
+                }
+                numFrames = static_cast<std::size_t>(eventFrame - frame);
+                break;
+            }
+        }
+
+        synth.renderBlock(buffer.data(), numFrames);
+        sink.write(buffer.data(), numFrames);
+        frame += numFrames;
+
+        if (frame >= endFrame && e == events.size() && isSilent(buffer, numFrames)) {
+            break;
+        }
+    }
+    return frame / sampleRate;
+}
+
+// renders live MIDI input to sink until interrupted, or until silence after end of stream if stream is given
+// rendering is kept at most bufferSize frames ahead of real time, unless fast
+void renderLive(primesynth::Synthesizer& synth, const primesynth::MIDIStreamInput* stream,
+                primesynth::AudioSink& sink, std::size_t bufferSize, double latency, bool fast) {
+    static constexpr std::size_t BLOCK_SIZE = 256;
+
+    const double sampleRate = synth.getSampleRate();
+    std::vector<float> buffer(2 * BLOCK_SIZE);
+    const auto start = std::chrono::steady_clock::now();
+    std::uint64_t frame = 0, endFrame = 0, maxFrame = 0;
+    while (!interrupted) {
+        if (fast && stream && !stream->hasReceived() && !stream->hasEnded()) {
+            // as messages take effect as soon as they are read, silence rendered before the first one has
+            // arbitrary length
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        if (!fast) {
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const double ahead = (static_cast<double>(frame) - bufferSize) / sampleRate - elapsed;
+            if (ahead > 0.0) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(ahead));
+            }
+        }
+
+        // checked before rendering, as the stream ends only after its last messages are queued,
+        // which the block must include before it can be judged silent
+        const bool ended = stream && stream->hasEnded();
+        synth.renderBlock(buffer.data(), BLOCK_SIZE);
+        sink.write(buffer.data(), BLOCK_SIZE);
+        frame += BLOCK_SIZE;
+
+        if (ended) {
+            if (maxFrame == 0) {
+                // last messages take effect up to twice the latency and a block later
+                endFrame = frame + static_cast<std::uint64_t>(2.0 * latency * sampleRate) + BLOCK_SIZE;
+                maxFrame = endFrame + static_cast<std::uint64_t>(MAX_TAIL_DURATION * sampleRate);
+            }
+            if (frame >= maxFrame || (frame >= endFrame && isSilent(buffer, BLOCK_SIZE))) {
+                break;
+            }
+        }
+    }
+}
 
 int main(int argc, char** argv) {
     try {
@@ -14,19 +151,68 @@ int main(int argc, char** argv) {
         argparser.add<double>("volume", 'v', "volume (1 = 100%)", false, 1.0);
         argparser.add<double>("samplerate", 's', "sample rate (Hz)", false);
         argparser.add<unsigned int>("buffer", 'b', "audio output buffer size", false, 1 << 12);
+        argparser.add("pull", '\0', "render in audio callback for lower latency instead of buffering ahead");
         argparser.add<unsigned int>("channels", 'c', "number of MIDI channels", false, 16);
+        argparser.add<std::string>("interp", '\0', "sample interpolation (none, linear, cubic, sinc)", false, "linear",
+                                   cmdline::oneof<std::string>("none", "linear", "cubic", "sinc"));
+        argparser.add<unsigned int>("control", '\0', "frames between updates of envelopes and LFOs (16, 32, 64, 128)",
+                                    false, 64, cmdline::oneof<unsigned int>(16, 32, 64, 128));
+        argparser.add<double>("latency", 'l', "MIDI input latency for accurate timing (ms, 0 = as soon as possible)",
+                              false, 5.0);
+        argparser.add<unsigned int>("threads", 't', "number of rendering threads", false, 1);
+        argparser.add<unsigned int>("polyphony", '\0', "maximum number of voices", false, 256);
+        argparser.add<std::string>("steal", '\0', "voice stealing policy (released, quietest, priority)", false,
+                                   "released", cmdline::oneof<std::string>("released", "quietest", "priority"));
         argparser.add<std::string>("std", '\0', "MIDI standard, affects bank selection (gm, gs, xg)", false, "gs",
                                    cmdline::oneof<std::string>("gm", "gs", "xg"));
         argparser.add("fix-std", '\0', "do not respond to GM/XG System On, GS Reset, etc.");
+        argparser.add("mmap", '\0', "map SoundFont sample data into memory instead of loading it");
         argparser.add("print-msg", 'p', "print received MIDI messages");
+        argparser.add<std::string>("midi-in", '\0', "read raw MIDI stream from file, FIFO or device node (- = stdin)",
+                                   false);
+        argparser.add("fast", '\0', "render --midi-in at full speed instead of in real time, unless --sink is device");
+        argparser.add<std::string>("render", 'r', "render Standard MIDI File at full speed instead of playing live",
+                                   false);
+        argparser.add<std::string>("sink", '\0', "audio destination (device, wav, raw, null), wav if --render", false,
+                                   "device", cmdline::oneof<std::string>("device", "wav", "raw", "null"));
+        argparser.add<std::string>("output", 'w', "output file of --sink, - = stdout (default: out.wav, - for raw)",
+                                   false);
+        argparser.add<std::string>("format", '\0', "sample format of --sink (int16, int24, float)", false, "int16",
+                                   cmdline::oneof<std::string>("int16", "int24", "float"));
         argparser.footer("[soundfonts] ...");
         argparser.parse_check(argc, argv);
         if (argparser.rest().empty()) {
             throw std::runtime_error("SoundFont file required");
         }
 
-        const double sampleRate =
-            argparser.exist("samplerate") ? argparser.get<double>("samplerate") : AudioOutput::getDefaultSampleRate();
+        const bool offline = argparser.exist("render");
+        std::string sinkType = offline ? "wav" : "device";
+        if (argparser.exist("sink")) {
+            sinkType = argparser.get<std::string>("sink");
+        }
+        if (offline && sinkType == "device") {
+            throw std::runtime_error("--render requires --sink other than device");
+        }
+#ifdef PRIMESYNTH_NO_PORTAUDIO
+        if (sinkType == "device") {
+            throw std::runtime_error("built without PortAudio, --sink other than device required");
+        }
+#endif
+        std::string outputFilename = sinkType == "wav" ? "out.wav" : "-";
+        if (argparser.exist("output")) {
+            outputFilename = argparser.get<std::string>("output");
+        }
+        // keep stdout clean for piped audio
+        std::ostream& log = sinkType == "raw" && outputFilename == "-" ? std::cerr : std::cout;
+
+        double sampleRate = 44100.0;
+        if (argparser.exist("samplerate")) {
+            sampleRate = argparser.get<double>("samplerate");
+#ifndef PRIMESYNTH_NO_PORTAUDIO
+        } else if (sinkType == "device") {
+            sampleRate = AudioOutput::getDefaultSampleRate();
+#endif
+        }
 
         auto midiStandard = midi::Standard::GM;
         if (argparser.get<std::string>("std") == "gs") {
@@ -35,24 +221,111 @@ int main(int argc, char** argv) {
             midiStandard = midi::Standard::XG;
         }
 
+        auto interpolation = interp::Mode::Linear;
+        if (argparser.get<std::string>("interp") == "none") {
+            interpolation = interp::Mode::None;
+        } else if (argparser.get<std::string>("interp") == "cubic") {
+            interpolation = interp::Mode::Cubic;
+        } else if (argparser.get<std::string>("interp") == "sinc") {
+            interpolation = interp::Mode::Sinc;
+        }
+
+        auto stealingPolicy = StealingPolicy::OldestReleased;
+        if (argparser.get<std::string>("steal") == "quietest") {
+            stealingPolicy = StealingPolicy::Quietest;
+        } else if (argparser.get<std::string>("steal") == "priority") {
+            stealingPolicy = StealingPolicy::LowestPriority;
+        }
+
         Synthesizer synth(sampleRate, argparser.get<unsigned int>("channels"));
         synth.setMIDIStandard(midiStandard, argparser.exist("fix-std"));
+        synth.setInterpolation(interpolation);
+        synth.setCalcInterval(argparser.get<unsigned int>("control"));
+        synth.setPolyphony(argparser.get<unsigned int>("polyphony"));
+        synth.setStealingPolicy(stealingPolicy);
+        synth.setNumThreads(argparser.get<unsigned int>("threads"));
         synth.setVolume(argparser.get<double>("volume"));
         for (const std::string& filename : argparser.rest()) {
-            std::cout << "loading " << filename << std::endl;
-            synth.loadSoundFont(filename);
+            log << "loading " << filename << std::endl;
+            synth.loadSoundFont(filename, argparser.exist("mmap"));
         }
 
-        MIDIInput midiInput(synth, argparser.get<unsigned int>("in"), argparser.exist("print-msg"));
+        auto format = SampleFormat::Int16;
+        if (argparser.get<std::string>("format") == "int24") {
+            format = SampleFormat::Int24;
+        } else if (argparser.get<std::string>("format") == "float") {
+            format = SampleFormat::Float32;
+        }
+
+        if (offline) {
+            const MIDIFile midiFile(argparser.get<std::string>("render"));
+            const auto sink = createSink(sinkType, outputFilename, sampleRate, format);
+
+            log << "rendering " << argparser.get<std::string>("render") << std::endl;
+            const auto start = std::chrono::steady_clock::now();
+            const double duration = renderMIDIFile(synth, midiFile, *sink);
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            sink->close();
+
+            log << "rendered " << duration << " s in " << elapsed << " s (" << duration / elapsed << "x realtime)"
+                << std::endl;
+            return EXIT_SUCCESS;
+        }
+
+        // events take effect as soon as they are read when rendering as fast as possible
+        const bool fast = argparser.exist("fast") && sinkType != "device";
+        const double latency = fast ? 0.0 : argparser.get<double>("latency") / 1000.0;
+        // must outlive MIDI inputs
+        std::unique_ptr<MIDILogger> logger;
+        if (argparser.exist("print-msg")) {
+            logger = std::make_unique<MIDILogger>(log);
+        }
+        std::unique_ptr<MIDIStreamInput> midiStream;
+        if (argparser.exist("midi-in")) {
+            midiStream =
+                std::make_unique<MIDIStreamInput>(synth, argparser.get<std::string>("midi-in"), logger.get(), latency);
+        }
+#ifdef _WIN32
+        std::unique_ptr<MIDIInput> midiInput;
+        if (!midiStream) {
+            midiInput = std::make_unique<MIDIInput>(synth, argparser.get<unsigned int>("in"), logger.get(), latency);
+        }
+#else
+        if (!midiStream) {
+            throw std::runtime_error("MIDI input devices are only supported on Windows, use --midi-in");
+        }
+#endif
+
+        if (sinkType != "device") {
+            const auto sink = createSink(sinkType, outputFilename, sampleRate, format);
+            std::signal(SIGINT, handleInterrupt);
+            renderLive(synth, midiStream.get(), *sink, argparser.get<unsigned int>("buffer"), latency, fast);
+            sink->close();
+            return EXIT_SUCCESS;
+        }
+
+#ifndef PRIMESYNTH_NO_PORTAUDIO
         AudioOutput audioOutput(synth, argparser.get<unsigned int>("buffer"),
                                 argparser.exist("out") ? argparser.get<unsigned int>("out")
                                                        : AudioOutput::getDefaultDeviceID(),
-                                sampleRate);
+                                sampleRate, argparser.exist("pull"));
 
+#ifdef _WIN32
         SetPriorityClass(GetCurrentProcess(), REALTIME_PRIORITY_CLASS);
+#endif
 
-        std::cout << "Press enter to exit" << std::endl;
-        std::getchar();
+        if (midiStream) {
+            // stdin may be the MIDI stream
+            std::signal(SIGINT, handleInterrupt);
+            std::cout << "Press Ctrl+C to exit" << std::endl;
+            while (!interrupted) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        } else {
+            std::cout << "Press enter to exit" << std::endl;
+            std::getchar();
+        }
+#endif
     } catch (const std::exception& ex) {
         std::cerr << ex.what() << std::endl;
         return EXIT_FAILURE;
@@ -0,0 +1,82 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace primesynth {
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& filename) : mapping_(nullptr), data_(nullptr), size_(0) {
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open file");
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0) {
+        CloseHandle(file_);
+        throw std::runtime_error("failed to get file size");
+    }
+    size_ = static_cast<std::size_t>(size.QuadPart);
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) {
+        CloseHandle(file_);
+        throw std::runtime_error("failed to map file");
+    }
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_) {
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+        throw std::runtime_error("failed to map file");
+    }
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+#else
+MappedFile::MappedFile(const std::string& filename) : data_(nullptr), size_(0) {
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        throw std::runtime_error("failed to open file");
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+        close(fd_);
+        throw std::runtime_error("failed to get file size");
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (data == MAP_FAILED) {
+        close(fd_);
+        throw std::runtime_error("failed to map file");
+    }
+    data_ = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data_), size_);
+    close(fd_);
+}
+#endif
+
+const char* MappedFile::data() const {
+    return data_;
+}
+
+std::size_t MappedFile::size() const {
+    return size_;
+}
+}
@@ -1,9 +1,63 @@
 #include "midi.h"
+#include <iomanip>
 
 namespace primesynth {
 namespace midi {
 std::uint16_t joinBytes(std::uint8_t msb, std::uint8_t lsb) {
     return (static_cast<std::uint16_t>(msb) << 7) + static_cast<std::uint16_t>(lsb);
 }
+
+std::size_t getNumDataBytes(std::uint8_t status) {
+    switch (status & 0xf0) {
+    case 0xc0: // program change
+    case 0xd0: // channel pressure
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+void printShortMessage(std::ostream& os, std::uint32_t param) {
+    const auto msg = reinterpret_cast<const std::uint8_t*>(&param);
+    const auto status = static_cast<MessageStatus>(msg[0] & 0xf0);
+    const auto channel = msg[0] & 0xf;
+    switch (status) {
+    case MessageStatus::NoteOff:
+        os << "Note off: channel=" << channel << " key=" << static_cast<int>(msg[1]) << '\n';
+        break;
+    case MessageStatus::NoteOn:
+        os << "Note on: channel=" << channel << " key=" << static_cast<int>(msg[1])
+           << " velocity=" << static_cast<int>(msg[2]) << '\n';
+        break;
+    case MessageStatus::KeyPressure:
+        os << "Key pressure: channel=" << channel << " key=" << static_cast<int>(msg[1])
+           << " value=" << static_cast<int>(msg[2]) << '\n';
+        break;
+    case MessageStatus::ControlChange:
+        os << "Control change: channel=" << channel << " controller=" << static_cast<int>(msg[1])
+           << " value=" << static_cast<int>(msg[2]) << '\n';
+        break;
+    case MessageStatus::ProgramChange:
+        os << "Program change: channel=" << channel << " program=" << static_cast<int>(msg[1]) << '\n';
+        break;
+    case MessageStatus::ChannelPressure:
+        os << "Channel pressure: channel=" << channel << " value=" << static_cast<int>(msg[1]) << '\n';
+        break;
+    case MessageStatus::PitchBend:
+        os << "Pitch bend: channel=" << channel << " value=" << joinBytes(msg[2], msg[1]) << '\n';
+        break;
+    }
+}
+
+void printSysEx(std::ostream& os, const char* data, std::size_t length) {
+    os << "SysEx: ";
+    const auto flags(os.flags());
+    for (std::size_t i = 0; i < length; ++i) {
+        os << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(static_cast<unsigned char>(data[i]))
+           << " ";
+    }
+    os.flags(flags);
+    os << '\n';
+}
 }
 }
@@ -0,0 +1,217 @@
+#include "midi.h"
+#include "midi_file.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace primesynth {
+class ByteReader {
+public:
+    ByteReader(const std::uint8_t* begin, const std::uint8_t* end) : pos_(begin), end_(end) {}
+
+    bool atEnd() const {
+        return pos_ >= end_;
+    }
+
+    const std::uint8_t* getPosition() const {
+        return pos_;
+    }
+
+    std::uint8_t peek() const {
+        require(1);
+        return *pos_;
+    }
+
+    std::uint8_t readByte() {
+        require(1);
+        return *pos_++;
+    }
+
+    std::uint32_t readBigEndian(std::size_t numBytes) {
+        std::uint32_t value = 0;
+        for (std::size_t i = 0; i < numBytes; ++i) {
+            value = value << 8 | readByte();
+        }
+        return value;
+    }
+
+    std::uint32_t readVariableLength() {
+        std::uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const std::uint8_t byte = readByte();
+            value = value << 7 | (byte & 0x7f);
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("invalid variable-length quantity in MIDI file");
+    }
+
+    void skip(std::size_t numBytes) {
+        require(numBytes);
+        pos_ += numBytes;
+    }
+
+private:
+    const std::uint8_t* pos_;
+    const std::uint8_t* end_;
+
+    void require(std::size_t numBytes) const {
+        if (static_cast<std::size_t>(end_ - pos_) < numBytes) {
+            throw std::runtime_error("unexpected end of MIDI file");
+        }
+    }
+};
+
+struct TrackEvent {
+    std::uint64_t tick;
+    std::size_t track;
+    // microseconds per quarter note if tempo change, 0 otherwise
+    std::uint32_t tempo;
+    std::uint32_t param;
+    std::vector<char> sysEx;
+};
+
+// returns tick of end of track
+std::uint64_t readTrack(ByteReader& reader, std::size_t track, std::vector<TrackEvent>& events) {
+    std::uint64_t tick = 0;
+    std::uint8_t runningStatus = 0;
+    while (!reader.atEnd()) {
+        tick += reader.readVariableLength();
+
+        std::uint8_t status = reader.peek();
+        if (status & 0x80) {
+            reader.readByte();
+        } else if (runningStatus != 0) {
+            status = runningStatus;
+        } else {
+            throw std::runtime_error("MIDI data byte without status");
+        }
+
+        if (status < 0xf0) {
+            runningStatus = status;
+            std::uint32_t param = status;
+            for (std::size_t i = 0; i < midi::getNumDataBytes(status); ++i) {
+                param |= static_cast<std::uint32_t>(reader.readByte()) << (8 * (i + 1));
+            }
+            events.push_back({tick, track, 0, param, {}});
+            continue;
+        }
+
+        // SysEx and meta events cancel running status
+        runningStatus = 0;
+        if (status == 0xff) {
+            const std::uint8_t type = reader.readByte();
+            const std::uint32_t length = reader.readVariableLength();
+            if (type == 0x2f) {
+                // end of track
+                reader.skip(length);
+                break;
+            } else if (type == 0x51 && length == 3) {
+                events.push_back({tick, track, reader.readBigEndian(3), 0, {}});
+            } else {
+                reader.skip(length);
+            }
+        } else if (status == 0xf0) {
+            const std::uint32_t length = reader.readVariableLength();
+            const std::uint8_t* data = reader.getPosition();
+            reader.skip(length);
+            std::vector<char> sysEx;
+            sysEx.reserve(length + 1);
+            sysEx.push_back(static_cast<char>(0xf0));
+            sysEx.insert(sysEx.end(), data, data + length);
+            events.push_back({tick, track, 0, 0, std::move(sysEx)});
+        } else if (status == 0xf7) {
+            // escaped data such as SysEx continuation packets, not supported
+            reader.skip(reader.readVariableLength());
+        } else {
+            throw std::runtime_error("invalid status byte in MIDI file");
+        }
+    }
+    return tick;
+}
+
+MIDIFile::MIDIFile(const std::string& filename) : length_(0.0) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs) {
+        throw std::runtime_error("failed to open file");
+    }
+    const std::vector<std::uint8_t> data{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    ByteReader reader(data.data(), data.data() + data.size());
+
+    if (reader.readBigEndian(4) != 0x4d546864 /* MThd */) {
+        throw std::runtime_error("not a Standard MIDI File");
+    }
+    const std::uint32_t headerSize = reader.readBigEndian(4);
+    if (headerSize < 6) {
+        throw std::runtime_error("invalid MIDI file header");
+    }
+    const auto format = reader.readBigEndian(2);
+    const auto numTracks = reader.readBigEndian(2);
+    const auto division = reader.readBigEndian(2);
+    reader.skip(headerSize - 6);
+    if (format > 1) {
+        throw std::runtime_error("MIDI file format 2 not supported");
+    }
+
+    std::vector<TrackEvent> trackEvents;
+    std::uint64_t endTick = 0;
+    for (std::size_t track = 0; track < numTracks && !reader.atEnd();) {
+        const std::uint32_t chunkID = reader.readBigEndian(4);
+        const std::uint32_t chunkSize = reader.readBigEndian(4);
+        const std::uint8_t* chunkData = reader.getPosition();
+        reader.skip(chunkSize);
+        if (chunkID == 0x4d54726b /* MTrk */) {
+            ByteReader trackReader(chunkData, chunkData + chunkSize);
+            endTick = std::max(endTick, readTrack(trackReader, track, trackEvents));
+            ++track;
+        }
+    }
+
+    // events at same tick keep order within track, and earlier tracks (e.g. tempo track) come first
+    std::stable_sort(trackEvents.begin(), trackEvents.end(), [](const TrackEvent& a, const TrackEvent& b) {
+        return a.tick < b.tick || (a.tick == b.tick && a.track < b.track);
+    });
+
+    if ((division & 0x7fff) == 0 || (division & 0x80ff) == 0x8000) {
+        throw std::runtime_error("invalid MIDI file time division");
+    }
+    double secondsPerTick;
+    const bool smpte = (division & 0x8000) != 0;
+    if (smpte) {
+        // SMPTE time code, -29 means 29.97 fps
+        const int fps = -static_cast<std::int8_t>(division >> 8);
+        const double frameRate = fps == 29 ? 30000.0 / 1001.0 : fps;
+        secondsPerTick = 1.0 / (frameRate * (division & 0xff));
+    } else {
+        // 120 BPM until first tempo change
+        secondsPerTick = 500000e-6 / division;
+    }
+
+    double time = 0.0;
+    std::uint64_t lastTick = 0;
+    events_.reserve(trackEvents.size());
+    for (auto& event : trackEvents) {
+        time += (event.tick - lastTick) * secondsPerTick;
+        lastTick = event.tick;
+        if (event.tempo != 0) {
+            if (!smpte) {
+                secondsPerTick = event.tempo * 1e-6 / division;
+            }
+        } else {
+            events_.push_back({time, event.param, std::move(event.sysEx)});
+        }
+    }
+    length_ = time + (endTick - lastTick) * secondsPerTick;
+}
+
+const std::vector<MIDIFile::Event>& MIDIFile::getEvents() const {
+    return events_;
+}
+
+double MIDIFile::getLength() const {
+    return length_;
+}
+}
@@ -1,7 +1,8 @@
+#ifdef _WIN32
 #include "midi_input.h"
-#include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 
 namespace primesynth {
 void checkMMResult(MMRESULT result) {
@@ -14,7 +15,12 @@ void checkMMResult(MMRESULT result) {
     }
 }
 
-void CALLBACK MidiInProc(HMIDIIN, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD) {
+// timestamps of messages are ms since midiInStart
+std::uint64_t toFrame(MIDIInput::SharedParam& sp, DWORD time) {
+    return sp.scheduler.toFrame(time / 1000.0);
+}
+
+void CALLBACK MidiInProc(HMIDIIN, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD dwParam2) {
     const auto sp = reinterpret_cast<MIDIInput::SharedParam*>(dwInstance);
     if (!sp->running) {
         return;
@@ -22,11 +28,11 @@ void CALLBACK MidiInProc(HMIDIIN, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwP
 
     switch (wMsg) {
     case MIM_DATA:
-        sp->synth.processShortMessage(static_cast<std::uint32_t>(dwParam1));
+        sp->synth.processShortMessage(static_cast<std::uint32_t>(dwParam1), toFrame(*sp, dwParam2));
         break;
     case MIM_LONGDATA: {
         const auto mh = reinterpret_cast<LPMIDIHDR>(dwParam1);
-        sp->synth.processSysEx(mh->lpData, mh->dwBytesRecorded);
+        sp->synth.processSysEx(mh->lpData, mh->dwBytesRecorded, toFrame(*sp, dwParam2));
 
         // See "MidiInProc callback function" (https://msdn.microsoft.com/en-us/library/dd798460.aspx)
         // "Applications should not call any multimedia functions from inside the callback function, as doing so can
@@ -46,50 +52,14 @@ void CALLBACK verboseMidiInProc(HMIDIIN hmi, UINT wMsg, DWORD_PTR dwInstance, DW
         return;
     }
 
+    // logging only copies message into queue, and is done first as SysEx buffer is reused once processed
     switch (wMsg) {
-    case MIM_DATA: {
-        const auto param = static_cast<std::uint32_t>(dwParam1);
-        const auto msg = reinterpret_cast<const std::uint8_t*>(&param);
-        const auto status = static_cast<midi::MessageStatus>(msg[0] & 0xf0);
-        const auto channel = msg[0] & 0xf;
-        switch (status) {
-        case midi::MessageStatus::NoteOff:
-            std::cout << "Note off: channel=" << channel << " key=" << static_cast<int>(msg[1]) << std::endl;
-            break;
-        case midi::MessageStatus::NoteOn:
-            std::cout << "Note on: channel=" << channel << " key=" << static_cast<int>(msg[1])
-                      << " velocity=" << static_cast<int>(msg[2]) << std::endl;
-            break;
-        case midi::MessageStatus::KeyPressure:
-            std::cout << "Key pressure: channel=" << channel << " key=" << static_cast<int>(msg[1])
-                      << " value=" << static_cast<int>(msg[2]) << std::endl;
-            break;
-        case midi::MessageStatus::ControlChange:
-            std::cout << "Control change: channel=" << channel << " controller=" << static_cast<int>(msg[1])
-                      << " value=" << static_cast<int>(msg[2]) << std::endl;
-            break;
-        case midi::MessageStatus::ProgramChange:
-            std::cout << "Program change: channel=" << channel << " program=" << static_cast<int>(msg[1]) << std::endl;
-            break;
-        case midi::MessageStatus::ChannelPressure:
-            std::cout << "Channel pressure: channel=" << channel << " value=" << static_cast<int>(msg[1]) << std::endl;
-            break;
-        case midi::MessageStatus::PitchBend:
-            std::cout << "Pitch bend: channel=" << channel << " value=" << midi::joinBytes(msg[2], msg[1]) << std::endl;
-            break;
-        }
+    case MIM_DATA:
+        sp->logger->logShortMessage(static_cast<std::uint32_t>(dwParam1));
         break;
-    }
     case MIM_LONGDATA: {
         const auto mh = reinterpret_cast<LPMIDIHDR>(dwParam1);
-        std::cout << "SysEx: ";
-        const auto flags(std::cout.flags());
-        for (DWORD i = 0; i < mh->dwBytesRecorded; ++i) {
-            std::cout << std::hex << std::setfill('0') << std::setw(2)
-                      << static_cast<int>(static_cast<unsigned char>(mh->lpData[i])) << " ";
-        }
-        std::cout.flags(flags);
-        std::cout << std::endl;
+        sp->logger->logSysEx(mh->lpData, mh->dwBytesRecorded);
         break;
     }
     }
@@ -97,12 +67,12 @@ void CALLBACK verboseMidiInProc(HMIDIIN hmi, UINT wMsg, DWORD_PTR dwInstance, DW
     MidiInProc(hmi, wMsg, dwInstance, dwParam1, dwParam2);
 }
 
-MIDIInput::MIDIInput(Synthesizer& synth, UINT deviceID, bool verbose)
-    : sysExBuffer_(512), mh_(), sharedParam_{synth, true, false} {
+MIDIInput::MIDIInput(Synthesizer& synth, UINT deviceID, MIDILogger* logger, double latency)
+    : sysExBuffer_(512), mh_(), sharedParam_{synth, {synth, latency}, logger, true, false} {
     MIDIINCAPS caps;
     checkMMResult(midiInGetDevCaps(deviceID, &caps, sizeof(caps)));
     std::wcout << "MIDI: opening " << caps.szPname << std::endl;
-    checkMMResult(midiInOpen(&hmi_, deviceID, reinterpret_cast<DWORD_PTR>(verbose ? verboseMidiInProc : MidiInProc),
+    checkMMResult(midiInOpen(&hmi_, deviceID, reinterpret_cast<DWORD_PTR>(logger ? verboseMidiInProc : MidiInProc),
                              reinterpret_cast<DWORD_PTR>(&sharedParam_), CALLBACK_FUNCTION));
 
     mh_.lpData = sysExBuffer_.data();
@@ -142,3 +112,4 @@ MIDIInput::~MIDIInput() {
     }
 }
 }
+#endif
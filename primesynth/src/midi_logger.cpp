@@ -0,0 +1,111 @@
+#include "midi.h"
+#include "midi_logger.h"
+#include <chrono>
+#include <cstring>
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace primesynth {
+// type, and parameter of short message or length of SysEx
+static constexpr std::size_t RECORD_HEADER_SIZE = 1 + sizeof(std::uint32_t);
+// printing thread sleeps this long when queue is empty
+static constexpr auto PRINT_INTERVAL = std::chrono::milliseconds(10);
+// longest SysEx received by MIDIInput
+static constexpr std::size_t TYPICAL_MAX_SYSEX_LENGTH = 512;
+
+void lowerCurrentThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+    const sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+MIDILogger::MIDILogger(std::ostream& os, std::size_t capacity)
+    : os_(os),
+      queue_(capacity),
+      numDropped_(0),
+      running_(true),
+      printingThread_(&MIDILogger::doPrintingLoop, this) {
+    record_.reserve(RECORD_HEADER_SIZE + TYPICAL_MAX_SYSEX_LENGTH);
+}
+
+MIDILogger::~MIDILogger() {
+    running_ = false;
+    if (printingThread_.joinable()) {
+        printingThread_.join();
+    }
+}
+
+void MIDILogger::logShortMessage(std::uint32_t param) {
+    queueRecord(RecordType::ShortMessage, param, nullptr, 0);
+}
+
+void MIDILogger::logSysEx(const char* data, std::size_t length) {
+    queueRecord(RecordType::SysEx, static_cast<std::uint32_t>(length), data, length);
+}
+
+void MIDILogger::queueRecord(RecordType type, std::uint32_t value, const char* data, std::size_t length) {
+    const std::size_t size = RECORD_HEADER_SIZE + length;
+    if (queue_.writable() < size) {
+        numDropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    record_.resize(size);
+    record_[0] = static_cast<char>(type);
+    std::memcpy(&record_[1], &value, sizeof(value));
+    if (length > 0) {
+        std::memcpy(&record_[RECORD_HEADER_SIZE], data, length);
+    }
+    queue_.write(record_.data(), size);
+}
+
+void MIDILogger::doPrintingLoop() {
+    lowerCurrentThreadPriority();
+    while (true) {
+        // messages logged before stop are still printed
+        const bool stopping = !running_;
+        if (!printQueued()) {
+            if (stopping) {
+                break;
+            }
+            std::this_thread::sleep_for(PRINT_INTERVAL);
+        }
+    }
+}
+
+bool MIDILogger::printQueued() {
+    const std::size_t numDropped = numDropped_.exchange(0, std::memory_order_relaxed);
+    if (queue_.readable() == 0 && numDropped == 0) {
+        return false;
+    }
+
+    std::vector<char> sysEx;
+    // records are queued whole, so data follows whenever header is readable
+    while (queue_.readable() >= RECORD_HEADER_SIZE) {
+        char header[RECORD_HEADER_SIZE];
+        queue_.read(header, RECORD_HEADER_SIZE);
+        std::uint32_t value;
+        std::memcpy(&value, &header[1], sizeof(value));
+        if (static_cast<RecordType>(header[0]) == RecordType::ShortMessage) {
+            midi::printShortMessage(os_, value);
+        } else {
+            sysEx.resize(value);
+            queue_.read(sysEx.data(), value);
+            midi::printSysEx(os_, sysEx.data(), value);
+        }
+    }
+    if (numDropped > 0) {
+        os_ << numDropped << " MIDI messages not printed as log queue was full\n";
+    }
+    // flush once per batch instead of per message
+    os_.flush();
+    return true;
+}
+}
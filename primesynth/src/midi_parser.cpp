@@ -0,0 +1,116 @@
+#include "midi.h"
+#include "midi_parser.h"
+
+namespace primesynth {
+// number of data bytes following status byte of system common message
+std::size_t getNumSystemDataBytes(std::uint8_t status) {
+    switch (status) {
+    case 0xf1: // MTC quarter frame
+    case 0xf3: // song select
+        return 1;
+    case 0xf2: // song position pointer
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+MIDIParser::MIDIParser()
+    : status_(0),
+      runningStatus_(0),
+      dataBytes_(),
+      numDataBytes_(0),
+      expectedDataBytes_(0),
+      inSysEx_(false),
+      sysExLength_(0),
+      sysEx_() {}
+
+void MIDIParser::parse(const std::uint8_t* data, std::size_t size, std::vector<MIDIEvent>& events) {
+    for (std::size_t i = 0; i < size; ++i) {
+        if (data[i] >= 0xf8) {
+            // real-time messages may appear anywhere, even inside other messages, without affecting them
+            continue;
+        }
+        if (data[i] & 0x80) {
+            parseStatus(data[i], events);
+        } else {
+            parseData(data[i], events);
+        }
+    }
+}
+
+void MIDIParser::parseStatus(std::uint8_t status, std::vector<MIDIEvent>& events) {
+    if (inSysEx_) {
+        inSysEx_ = false;
+        // SysEx is terminated by EOX, and any other status byte aborts it
+        if (status == 0xf7) {
+            if (sysExLength_ < sysEx_.size()) {
+                MIDIEvent event = {};
+                event.type = MIDIEvent::Type::SysEx;
+                sysEx_.at(sysExLength_++) = static_cast<char>(status);
+                event.sysExLength = static_cast<std::uint8_t>(sysExLength_);
+                event.sysEx = sysEx_;
+                events.push_back(event);
+            }
+            return;
+        }
+    }
+
+    numDataBytes_ = 0;
+    if (status < 0xf0) {
+        status_ = runningStatus_ = status;
+        expectedDataBytes_ = midi::getNumDataBytes(status);
+        return;
+    }
+
+    // system common messages cancel running status
+    runningStatus_ = 0;
+    status_ = 0;
+    if (status == 0xf0) {
+        inSysEx_ = true;
+        sysEx_.at(0) = static_cast<char>(status);
+        sysExLength_ = 1;
+    } else {
+        expectedDataBytes_ = getNumSystemDataBytes(status);
+        if (expectedDataBytes_ > 0) {
+            status_ = status;
+        }
+    }
+}
+
+void MIDIParser::parseData(std::uint8_t data, std::vector<MIDIEvent>& events) {
+    if (inSysEx_) {
+        // overlong SysEx is only counted so that it is dropped at EOX
+        if (sysExLength_ < sysEx_.size()) {
+            sysEx_.at(sysExLength_) = static_cast<char>(data);
+        }
+        ++sysExLength_;
+        return;
+    }
+
+    if (status_ == 0) {
+        if (runningStatus_ == 0) {
+            // data byte without status
+            return;
+        }
+        status_ = runningStatus_;
+        numDataBytes_ = 0;
+        expectedDataBytes_ = midi::getNumDataBytes(status_);
+    }
+
+    dataBytes_.at(numDataBytes_++) = data;
+    if (numDataBytes_ < expectedDataBytes_) {
+        return;
+    }
+    if (status_ < 0xf0) {
+        MIDIEvent event = {};
+        event.type = MIDIEvent::Type::ShortMessage;
+        event.param = status_;
+        for (std::size_t i = 0; i < numDataBytes_; ++i) {
+            event.param |= static_cast<std::uint32_t>(dataBytes_.at(i)) << (8 * (i + 1));
+        }
+        events.push_back(event);
+    }
+    status_ = 0;
+}
+}
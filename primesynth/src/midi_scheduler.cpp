@@ -0,0 +1,38 @@
+#include "midi_scheduler.h"
+#include <algorithm>
+
+namespace primesynth {
+MIDIScheduler::MIDIScheduler(const Synthesizer& synth, double latency)
+    : synth_(synth),
+      latencyFrames_(latency * synth.getSampleRate()),
+      anchored_(false),
+      anchorTime_(0.0),
+      anchorFrame_(0),
+      lastFrame_(0) {}
+
+std::uint64_t MIDIScheduler::toFrame(double time) {
+    if (latencyFrames_ <= 0.0) {
+        return 0;
+    }
+
+    const std::uint64_t currentFrame = synth_.getCurrentFrame();
+    const auto latency = static_cast<std::uint64_t>(latencyFrames_);
+    // frames rendered ahead of real time vary by up to a block, which can be longer than latency
+    const std::uint64_t period = synth_.getLargestBlockSize();
+    std::uint64_t frame = 0;
+    if (anchored_ && time >= anchorTime_) {
+        frame = anchorFrame_ + static_cast<std::uint64_t>((time - anchorTime_) * synth_.getSampleRate());
+    }
+    // re-anchor on first message, or when clocks of MIDI and audio have drifted apart (e.g. after underrun)
+    // by more than latency and a block
+    if (!anchored_ || frame + period < currentFrame || frame > currentFrame + 2 * latency + period) {
+        anchored_ = true;
+        anchorTime_ = time;
+        anchorFrame_ = currentFrame + latency;
+        frame = anchorFrame_;
+    }
+    frame = std::max(frame, lastFrame_);
+    lastFrame_ = frame;
+    return frame;
+}
+}
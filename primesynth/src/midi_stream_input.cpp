@@ -0,0 +1,199 @@
+#include "midi_stream_input.h"
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace primesynth {
+// reading thread checks for stop request at this interval while no data arrives
+static constexpr int POLL_TIMEOUT_MS = 100;
+
+int openStream(const std::string& filename) {
+    if (filename == "-") {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        return _fileno(stdin);
+#else
+        return STDIN_FILENO;
+#endif
+    }
+#ifdef _WIN32
+    const int fd = _open(filename.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+#endif
+    if (fd < 0) {
+        throw std::runtime_error("failed to open MIDI stream");
+    }
+    return fd;
+}
+
+void closeStream(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+// returns false if no data has arrived within timeout
+bool waitReadable(int fd, int timeoutMs) {
+#ifdef _WIN32
+    // CRT file descriptors cannot be polled, so read blocks instead and is cancelled on stop request
+    return true;
+#else
+    pollfd pfd = {fd, POLLIN, 0};
+    const int result = poll(&pfd, 1, timeoutMs);
+    return result > 0 || (result < 0 && errno != EINTR);
+#endif
+}
+
+// returns number of bytes read, 0 at end of stream, or negative value if interrupted
+long readStream(int fd, std::uint8_t* buffer, std::size_t size) {
+#ifdef _WIN32
+    const int result = _read(fd, buffer, static_cast<unsigned int>(size));
+    if (result < 0 && GetLastError() == ERROR_OPERATION_ABORTED) {
+        return -1;
+    }
+#else
+    const ssize_t result = read(fd, buffer, size);
+    if (result < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return -1;
+    }
+#endif
+    if (result < 0) {
+        throw std::runtime_error("failed to read MIDI stream");
+    }
+    return static_cast<long>(result);
+}
+
+double getArrivalTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MIDIStreamInput::MIDIStreamInput(Synthesizer& synth, int fd, MIDILogger* logger, double latency)
+    : MIDIStreamInput(synth, fd, false, logger, latency) {}
+
+MIDIStreamInput::MIDIStreamInput(Synthesizer& synth, const std::string& filename, MIDILogger* logger,
+                                 double latency)
+    : MIDIStreamInput(synth, openStream(filename), filename != "-", logger, latency) {}
+
+MIDIStreamInput::MIDIStreamInput(Synthesizer& synth, int fd, bool ownsFD, MIDILogger* logger, double latency)
+    : synth_(synth),
+      fd_(fd),
+      ownsFD_(ownsFD),
+      logger_(logger),
+      scheduler_(synth, latency),
+      running_(true),
+      received_(false),
+      ended_(false),
+#ifdef _WIN32
+      readingThreadHandle_(nullptr),
+#endif
+      readingThread_(&MIDIStreamInput::doReadingLoop, this) {}
+
+MIDIStreamInput::~MIDIStreamInput() {
+    running_ = false;
+#ifdef _WIN32
+    // retry, as cancellation has no effect if the thread is just about to read
+    while (!ended_) {
+        if (const HANDLE thread = readingThreadHandle_) {
+            CancelSynchronousIo(thread);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+#endif
+    if (readingThread_.joinable()) {
+        readingThread_.join();
+    }
+#ifdef _WIN32
+    if (const HANDLE thread = readingThreadHandle_) {
+        CloseHandle(thread);
+    }
+#endif
+    if (ownsFD_) {
+        closeStream(fd_);
+    }
+}
+
+bool MIDIStreamInput::hasReceived() const {
+    return received_;
+}
+
+bool MIDIStreamInput::hasEnded() const {
+    return ended_;
+}
+
+void MIDIStreamInput::doReadingLoop() {
+#ifdef _WIN32
+    // GetCurrentThread returns a pseudo handle, which is valid only within this thread
+    HANDLE thread;
+    if (DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread, 0, FALSE,
+                        DUPLICATE_SAME_ACCESS)) {
+        readingThreadHandle_ = thread;
+    }
+#endif
+
+    std::array<std::uint8_t, 4096> buffer;
+    try {
+        while (running_) {
+            if (!waitReadable(fd_, POLL_TIMEOUT_MS)) {
+                continue;
+            }
+            const long numRead = readStream(fd_, buffer.data(), buffer.size());
+            if (numRead == 0) {
+                break;
+            } else if (numRead < 0) {
+                continue;
+            }
+
+            const std::uint64_t frame = scheduler_.toFrame(getArrivalTime());
+            events_.clear();
+            parser_.parse(buffer.data(), static_cast<std::size_t>(numRead), events_);
+            for (auto& event : events_) {
+                event.frame = frame;
+            }
+            queueEvents();
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+    }
+    ended_ = true;
+}
+
+void MIDIStreamInput::queueEvents() {
+    std::size_t numQueued = 0;
+    while (running_) {
+        numQueued += synth_.processEvents(events_.data() + numQueued, events_.size() - numQueued);
+        if (numQueued == events_.size()) {
+            break;
+        }
+        // event queue is full, wait for rendering thread to consume it instead of dropping messages
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!events_.empty()) {
+        received_ = true;
+    }
+
+    if (logger_) {
+        for (const auto& event : events_) {
+            if (event.type == MIDIEvent::Type::ShortMessage) {
+                logger_->logShortMessage(event.param);
+            } else {
+                logger_->logSysEx(event.sysEx.data(), event.sysExLength);
+            }
+        }
+    }
+}
+}
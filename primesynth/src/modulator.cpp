@@ -1,30 +1,151 @@
 #include "conversion.h"
 #include "modulator.h"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
+#include <utility>
 
 namespace primesynth {
-Modulator::Modulator(const sf::ModList& param) : param_(param), source_(0.0), amountSource_(1.0), value_(0.0) {}
+double ModulatorCurve::operator()(double position) const {
+    position = std::min(std::max(position, 0.0), static_cast<double>(CURVE_RESOLUTION));
+    const std::size_t i = std::min(static_cast<std::size_t>(position), CURVE_RESOLUTION - 1);
+    return values[i] + interpolation * (position - i) * (values[i + 1] - values[i]);
+}
+
+// x is normalized source value in [0, 1]
+double evaluateCurve(double x, sf::SourceType type, sf::SourcePolarity polarity, sf::SourceDirection direction) {
+    if (type == sf::SourceType::Switch) {
+        const double off = polarity == sf::SourcePolarity::Unipolar ? 0.0 : -1.0;
+        const double y = direction == sf::SourceDirection::Positive ? x : 1.0 - x;
+        return y >= 0.5 ? 1.0 : off;
+    } else if (polarity == sf::SourcePolarity::Unipolar) {
+        const double y = direction == sf::SourceDirection::Positive ? x : 1.0 - x;
+        switch (type) {
+        case sf::SourceType::Linear:
+            return y;
+        case sf::SourceType::Concave:
+            return conv::concave(y);
+        case sf::SourceType::Convex:
+            return conv::convex(y);
+        default:
+            break;
+        }
+    } else {
+        const int dir = direction == sf::SourceDirection::Positive ? 1 : -1;
+        const int sign = x > 0.5 ? 1 : -1;
+        const double y = 2.0 * x - 1.0;
+        switch (type) {
+        case sf::SourceType::Linear:
+            return dir * y;
+        case sf::SourceType::Concave:
+            return sign * dir * conv::concave(sign * y);
+        case sf::SourceType::Convex:
+            return sign * dir * conv::convex(sign * y);
+        default:
+            break;
+        }
+    }
+    throw std::runtime_error("unknown modulator controller type");
+}
 
-sf::Generator Modulator::getDestination() const {
-    return param_.modDestOper;
+static constexpr std::size_t NUM_SOURCE_TYPES = 4;
+
+bool isNoController(const sf::Modulator& mod) {
+    return mod.palette == sf::ControllerPalette::General && mod.index.general == sf::GeneralController::NoController;
+}
+
+bool hasKnownType(const sf::Modulator& mod) {
+    return static_cast<std::size_t>(mod.type) < NUM_SOURCE_TYPES;
 }
 
-std::int16_t Modulator::getAmount() const {
-    return param_.modAmount;
+// returns curve for type, polarity and direction of given source, or nullptr if source is not used
+const ModulatorCurve* getCurve(const sf::Modulator& mod) {
+    if (isNoController(mod)) {
+        return nullptr;
+    }
+
+    static const auto curves = [] {
+        std::array<ModulatorCurve, NUM_SOURCE_TYPES * 4> c;
+        for (std::size_t i = 0; i < c.size(); ++i) {
+            const auto type = static_cast<sf::SourceType>(i / 4);
+            const auto polarity = static_cast<sf::SourcePolarity>(i / 2 % 2);
+            const auto direction = static_cast<sf::SourceDirection>(i % 2);
+            for (std::size_t j = 0; j <= CURVE_RESOLUTION; ++j) {
+                c.at(i).values.at(j) =
+                    evaluateCurve(static_cast<double>(j) / CURVE_RESOLUTION, type, polarity, direction);
+            }
+            c.at(i).interpolation = type == sf::SourceType::Switch ? 0.0 : 1.0;
+        }
+        return c;
+    }();
+    return &curves.at(4 * static_cast<std::size_t>(mod.type) + 2 * static_cast<std::size_t>(mod.polarity) +
+                      static_cast<std::size_t>(mod.direction));
+}
+
+double getScale(const sf::Modulator& mod) {
+    // pitch wheel is 14 bit while others are 7 bit
+    const bool pitchWheel =
+        mod.palette == sf::ControllerPalette::General && mod.index.general == sf::GeneralController::PitchWheel;
+    return pitchWheel ? static_cast<double>(CURVE_RESOLUTION) / (1 << 14) : CURVE_RESOLUTION / 128.0;
+}
+
+bool usesController(const sf::Modulator& mod, sf::ControllerPalette palette, std::uint8_t index) {
+    return mod.palette == palette && mod.index.midi == index;
+}
+
+template <typename T>
+void appendUnique(std::vector<T>& vector, T value) {
+    if (std::find(vector.begin(), vector.end(), value) == vector.end()) {
+        vector.push_back(value);
+    }
+}
+
+ModulatorRouting::ModulatorRouting(const std::vector<sf::ModList>& params) : routes_(1) {
+    for (const auto& param : params) {
+        const bool knownTypes = (isNoController(param.modSrcOper) || hasKnownType(param.modSrcOper)) &&
+                                (isNoController(param.modAmtSrcOper) || hasKnownType(param.modAmtSrcOper));
+        if (modulators_.size() < MAX_MODULATORS && static_cast<std::size_t>(param.modDestOper) < NUM_GENERATORS &&
+            knownTypes) {
+            modulators_.push_back({param, getCurve(param.modSrcOper), getCurve(param.modAmtSrcOper),
+                                   getScale(param.modSrcOper), getScale(param.modAmtSrcOper)});
+        }
+    }
+
+    buildRoutes(sf::ControllerPalette::General, sfRouteIndices_);
+    buildRoutes(sf::ControllerPalette::MIDI, midiRouteIndices_);
+
+    for (std::size_t dest = 0; dest < NUM_GENERATORS; ++dest) {
+        destinationOffsets_.at(dest) = static_cast<std::uint8_t>(byDestination_.size());
+        for (std::size_t i = 0; i < modulators_.size(); ++i) {
+            if (static_cast<std::size_t>(modulators_.at(i).param.modDestOper) == dest) {
+                byDestination_.push_back(static_cast<std::uint8_t>(i));
+            }
+        }
+    }
+    destinationOffsets_.at(NUM_GENERATORS) = static_cast<std::uint8_t>(byDestination_.size());
 }
 
-bool Modulator::canBeNegative() const {
-    if (param_.modTransOper == sf::Transform::AbsoluteValue || param_.modAmount == 0) {
+std::size_t ModulatorRouting::size() const {
+    return modulators_.size();
+}
+
+const CompiledModulator& ModulatorRouting::getModulator(std::size_t i) const {
+    return modulators_[i];
+}
+
+bool ModulatorRouting::canBeNegative(std::size_t i) const {
+    const sf::ModList& param = modulators_.at(i).param;
+    if (param.modTransOper == sf::Transform::AbsoluteValue || param.modAmount == 0) {
         return false;
     }
 
-    if (param_.modAmount > 0) {
-        const bool noSrc = param_.modSrcOper.palette == sf::ControllerPalette::General &&
-                           param_.modSrcOper.index.general == sf::GeneralController::NoController;
-        const bool uniSrc = param_.modSrcOper.polarity == sf::SourcePolarity::Unipolar;
-        const bool noAmt = param_.modAmtSrcOper.palette == sf::ControllerPalette::General &&
-                           param_.modAmtSrcOper.index.general == sf::GeneralController::NoController;
-        const bool uniAmt = param_.modAmtSrcOper.polarity == sf::SourcePolarity::Unipolar;
+    if (param.modAmount > 0) {
+        const bool noSrc = param.modSrcOper.palette == sf::ControllerPalette::General &&
+                           param.modSrcOper.index.general == sf::GeneralController::NoController;
+        const bool uniSrc = param.modSrcOper.polarity == sf::SourcePolarity::Unipolar;
+        const bool noAmt = param.modAmtSrcOper.palette == sf::ControllerPalette::General &&
+                           param.modAmtSrcOper.index.general == sf::GeneralController::NoController;
+        const bool uniAmt = param.modAmtSrcOper.polarity == sf::SourcePolarity::Unipolar;
 
         if ((uniSrc && uniAmt) || (uniSrc && noAmt) || (noSrc && uniAmt) || (noSrc && noAmt)) {
             return false;
@@ -34,80 +155,86 @@ bool Modulator::canBeNegative() const {
     return true;
 }
 
-double Modulator::getValue() const {
-    return value_;
+const ModulatorRouting::Route& ModulatorRouting::getRoute(sf::GeneralController controller) const {
+    return routes_[sfRouteIndices_.at(static_cast<std::size_t>(controller))];
 }
 
-double map(double value, const sf::Modulator& mod) {
-    if (mod.palette == sf::ControllerPalette::General && mod.index.general == sf::GeneralController::PitchWheel) {
-        value /= 1 << 14;
-    } else {
-        value /= 1 << 7;
-    }
+const ModulatorRouting::Route& ModulatorRouting::getRoute(std::uint8_t midiController) const {
+    return routes_[midiRouteIndices_.at(midiController)];
+}
 
-    if (mod.type == sf::SourceType::Switch) {
-        const double off = mod.polarity == sf::SourcePolarity::Unipolar ? 0.0 : -1.0;
-        const double x = mod.direction == sf::SourceDirection::Positive ? value : 1.0 - value;
-        return x >= 0.5 ? 1.0 : off;
-    } else if (mod.polarity == sf::SourcePolarity::Unipolar) {
-        const double x = mod.direction == sf::SourceDirection::Positive ? value : 1.0 - value;
-        switch (mod.type) {
-        case sf::SourceType::Linear:
-            return x;
-        case sf::SourceType::Concave:
-            return conv::concave(x);
-        case sf::SourceType::Convex:
-            return conv::convex(x);
+const std::vector<std::uint8_t>& ModulatorRouting::getMIDIControllers() const {
+    return midiControllers_;
+}
+
+const std::vector<sf::Generator>& ModulatorRouting::getMIDIDestinations() const {
+    return midiDestinations_;
+}
+
+const std::uint8_t* ModulatorRouting::beginDestination(sf::Generator destination) const {
+    return byDestination_.data() + destinationOffsets_.at(static_cast<std::size_t>(destination));
+}
+
+const std::uint8_t* ModulatorRouting::endDestination(sf::Generator destination) const {
+    return byDestination_.data() + destinationOffsets_.at(static_cast<std::size_t>(destination) + 1);
+}
+
+void ModulatorRouting::buildRoutes(sf::ControllerPalette palette,
+                                   std::array<std::uint16_t, NUM_CONTROLLER_INDICES>& routeIndices) {
+    for (std::size_t index = 0; index < NUM_CONTROLLER_INDICES; ++index) {
+        const auto controller = static_cast<std::uint8_t>(index);
+        Route route;
+        for (std::size_t i = 0; i < modulators_.size(); ++i) {
+            const auto& param = modulators_.at(i).param;
+            if (usesController(param.modSrcOper, palette, controller) ||
+                usesController(param.modAmtSrcOper, palette, controller)) {
+                route.modulators.push_back(static_cast<std::uint8_t>(i));
+                appendUnique(route.destinations, param.modDestOper);
+            }
         }
-    } else {
-        const int dir = mod.direction == sf::SourceDirection::Positive ? 1 : -1;
-        const int sign = value > 0.5 ? 1 : -1;
-        const double x = 2.0 * value - 1.0;
-        switch (mod.type) {
-        case sf::SourceType::Linear:
-            return dir * x;
-        case sf::SourceType::Concave:
-            return sign * dir * conv::concave(sign * x);
-        case sf::SourceType::Convex:
-            return sign * dir * conv::convex(sign * x);
+
+        if (route.modulators.empty()) {
+            routeIndices.at(index) = 0;
+            continue;
+        }
+        if (palette == sf::ControllerPalette::MIDI) {
+            midiControllers_.push_back(controller);
+            for (const auto destination : route.destinations) {
+                appendUnique(midiDestinations_, destination);
+            }
         }
+        routeIndices.at(index) = static_cast<std::uint16_t>(routes_.size());
+        routes_.push_back(std::move(route));
     }
-    throw std::runtime_error("unknown modulator controller type");
 }
 
-bool Modulator::updateSFController(sf::GeneralController controller, double value) {
-    bool updated = false;
-    if (param_.modSrcOper.palette == sf::ControllerPalette::General && controller == param_.modSrcOper.index.general) {
-        source_ = map(value, param_.modSrcOper);
-        updated = true;
-    }
-    if (param_.modAmtSrcOper.palette == sf::ControllerPalette::General &&
-        controller == param_.modAmtSrcOper.index.general) {
-        amountSource_ = map(value, param_.modAmtSrcOper);
-        updated = true;
-    }
+Modulator::Modulator() : source_(0.0), amountSource_(1.0), value_(0.0) {}
 
-    if (updated) {
-        calculateValue();
-    }
-    return updated;
+double Modulator::getValue() const {
+    return value_;
 }
 
-bool Modulator::updateMIDIController(std::uint8_t controller, std::uint8_t value) {
-    bool updated = false;
-    if (param_.modSrcOper.palette == sf::ControllerPalette::MIDI && controller == param_.modSrcOper.index.midi) {
-        source_ = map(value, param_.modSrcOper);
-        updated = true;
+void Modulator::updateSFController(const CompiledModulator& mod, sf::GeneralController controller, double value) {
+    const sf::ModList& param = mod.param;
+    if (param.modSrcOper.palette == sf::ControllerPalette::General && controller == param.modSrcOper.index.general) {
+        source_ = (*mod.sourceCurve)(mod.sourceScale * value);
     }
-    if (param_.modAmtSrcOper.palette == sf::ControllerPalette::MIDI && controller == param_.modAmtSrcOper.index.midi) {
-        amountSource_ = map(value, param_.modAmtSrcOper);
-        updated = true;
+    if (param.modAmtSrcOper.palette == sf::ControllerPalette::General &&
+        controller == param.modAmtSrcOper.index.general) {
+        amountSource_ = (*mod.amountSourceCurve)(mod.amountSourceScale * value);
     }
+    calculateValue(param);
+}
 
-    if (updated) {
-        calculateValue();
+void Modulator::updateMIDIController(const CompiledModulator& mod, std::uint8_t controller, std::uint8_t value) {
+    const sf::ModList& param = mod.param;
+    if (param.modSrcOper.palette == sf::ControllerPalette::MIDI && controller == param.modSrcOper.index.midi) {
+        source_ = (*mod.sourceCurve)(mod.sourceScale * value);
+    }
+    if (param.modAmtSrcOper.palette == sf::ControllerPalette::MIDI && controller == param.modAmtSrcOper.index.midi) {
+        amountSource_ = (*mod.amountSourceCurve)(mod.amountSourceScale * value);
     }
-    return updated;
+    calculateValue(param);
 }
 
 double transform(double value, sf::Transform transform) {
@@ -120,7 +247,7 @@ double transform(double value, sf::Transform transform) {
     throw std::invalid_argument("unknown transform");
 }
 
-void Modulator::calculateValue() {
-    value_ = transform(param_.modAmount * source_ * amountSource_, param_.modTransOper);
+void Modulator::calculateValue(const sf::ModList& param) {
+    value_ = transform(param.modAmount * source_ * amountSource_, param.modTransOper);
 }
 }
@@ -1,13 +1,20 @@
 #include "conversion.h"
+#include "interpolation.h"
 #include "soundfont.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <stdexcept>
 
 namespace primesynth {
 std::string achToString(const char ach[20]) {
     return {ach, strnlen(ach, 20)};
 }
 
-Sample::Sample(const sf::Sample& sample, const std::vector<std::int16_t>& sampleBuffer)
+Sample::Sample(const sf::Sample& sample, const std::int16_t* sampleBuffer, std::size_t sampleBufferSize, bool scanPeak)
     : name(achToString(sample.sampleName)),
       start(sample.start),
       end(sample.end),
@@ -16,16 +23,25 @@ Sample::Sample(const sf::Sample& sample, const std::vector<std::int16_t>& sample
       sampleRate(sample.sampleRate),
       key(sample.originalKey),
       correction(sample.correction),
-      buffer(sampleBuffer) {
-    if (start < end) {
+      buffer(sampleBuffer),
+      bufferSize(sampleBufferSize),
+      seamBuffer(nullptr),
+      loopSeam(0) {
+    if (start >= end) {
+        minAtten = INFINITY;
+    } else if (scanPeak) {
+        if (end > bufferSize) {
+            throw std::runtime_error("sample out of range");
+        }
         int sampleMax = 0;
         // if SoundFont file is comformant to specification, generators do not extend sample range beyond start and end
         for (std::size_t i = start; i < end; ++i) {
-            sampleMax = std::max(sampleMax, std::abs(sampleBuffer.at(i)));
+            sampleMax = std::max(sampleMax, std::abs(sampleBuffer[i]));
         }
         minAtten = conv::amplitudeToAttenuation(static_cast<double>(sampleMax) / INT16_MAX);
     } else {
-        minAtten = INFINITY;
+        // assume full scale
+        minAtten = 0.0;
     }
 }
 
@@ -343,6 +359,10 @@ bool Zone::isInRange(std::int8_t key, std::int8_t velocity) const {
     return keyRange.contains(key) && velocityRange.contains(velocity);
 }
 
+Zone::Range intersect(const Zone::Range& a, const Zone::Range& b) {
+    return {std::max(a.min, b.min), std::min(a.max, b.max)};
+}
+
 void readBags(std::vector<Zone>& zones, std::vector<sf::Bag>::const_iterator bagBegin,
               std::vector<sf::Bag>::const_iterator bagEnd, const std::vector<sf::ModList>& mods,
               const std::vector<sf::GenList>& gens, sf::Generator indexGen) {
@@ -411,6 +431,40 @@ Preset::Preset(std::vector<sf::PresetHeader>::const_iterator phdrIter, const std
     : name(achToString(phdrIter->presetName)), bank(phdrIter->bank), presetID(phdrIter->preset), soundFont(sfont) {
     readBags(zones, pbag.begin() + phdrIter->presetBagNdx, pbag.begin() + std::next(phdrIter)->presetBagNdx, pmod, pgen,
              sf::Generator::Instrument);
+
+    const auto& instruments = sfont.getInstruments();
+    const auto& samples = sfont.getSamples();
+    for (const Zone& presetZone : zones) {
+        const auto instID = static_cast<std::uint16_t>(presetZone.generators.getOrDefault(sf::Generator::Instrument));
+        if (instID >= instruments.size()) {
+            continue;
+        }
+        for (const Zone& instZone : instruments.at(instID).zones) {
+            const auto sampleID = static_cast<std::uint16_t>(instZone.generators.getOrDefault(sf::Generator::SampleID));
+            if (sampleID >= samples.size()) {
+                continue;
+            }
+
+            const Zone::Range keyRange = intersect(presetZone.keyRange, instZone.keyRange);
+            const Zone::Range velocityRange = intersect(presetZone.velocityRange, instZone.velocityRange);
+            if (keyRange.min > keyRange.max || velocityRange.min > velocityRange.max) {
+                continue;
+            }
+
+            auto generators = instZone.generators;
+            generators.add(presetZone.generators);
+
+            auto modparams = instZone.modulatorParameters;
+            modparams.mergeAndAdd(presetZone.modulatorParameters);
+            modparams.merge(ModulatorParameterSet::getDefaultParameters());
+
+            for (int key = std::max<int>(0, keyRange.min); key <= keyRange.max; ++key) {
+                voiceTemplatesByKey.at(key).push_back(voiceTemplates.size());
+            }
+            voiceTemplates.push_back({keyRange, velocityRange, &samples.at(sampleID), generators,
+                                      ModulatorRouting(modparams.getParameters())});
+        }
+    }
 }
 
 struct RIFFHeader {
@@ -438,11 +492,14 @@ constexpr std::uint32_t toFourCC(const char str[5]) {
     return fourCC;
 }
 
-SoundFont::SoundFont(const std::string& filename) {
+SoundFont::SoundFont(const std::string& filename, bool memoryMapped) : sampleData_(nullptr), sampleDataSize_(0) {
     std::ifstream ifs(filename, std::ios::binary);
     if (!ifs) {
         throw std::runtime_error("failed to open file");
     }
+    if (memoryMapped) {
+        mappedFile_ = std::make_unique<MappedFile>(filename);
+    }
 
     const RIFFHeader riffHeader = readHeader(ifs);
     const std::uint32_t riffType = readFourCC(ifs);
@@ -531,8 +588,27 @@ void SoundFont::readSdtaChunk(std::ifstream& ifs, std::size_t size) {
             if (subchunkHeader.size == 0) {
                 throw std::runtime_error("no sample data found");
             }
-            sampleBuffer_.resize(subchunkHeader.size / sizeof(std::int16_t));
-            ifs.read(reinterpret_cast<char*>(sampleBuffer_.data()), subchunkHeader.size);
+            sampleDataSize_ = subchunkHeader.size / sizeof(std::int16_t);
+            if (mappedFile_) {
+                // RIFF chunks are aligned to 2 bytes, so are 16 bit samples in the mapping
+                const auto offset = static_cast<std::size_t>(ifs.tellg());
+                if (offset + subchunkHeader.size > mappedFile_->size()) {
+                    throw std::runtime_error("sample data out of file");
+                }
+                // samples near both ends are copied with guard points, but voices of samples out of range still
+                // read guard points from the data itself
+                if (sampleDataSize_ <= 2 * interp::GUARD_POINTS) {
+                    throw std::runtime_error("too little sample data to map");
+                }
+                sampleData_ = reinterpret_cast<const std::int16_t*>(mappedFile_->data() + offset);
+                ifs.ignore(subchunkHeader.size);
+            } else {
+                // surrounded by silent guard points so that interpolation can read beyond both ends
+                sampleBuffer_.assign(sampleDataSize_ + 2 * interp::GUARD_POINTS, 0);
+                ifs.read(reinterpret_cast<char*>(sampleBuffer_.data() + interp::GUARD_POINTS), subchunkHeader.size);
+                sampleData_ = sampleBuffer_.data();
+                sampleDataSize_ = sampleBuffer_.size();
+            }
             break;
         default:
             ifs.ignore(subchunkHeader.size);
@@ -627,6 +703,30 @@ void SoundFont::readPdtaChunk(std::ifstream& ifs, std::size_t size) {
 
     // last records of inst, phdr, and shdr sub-chunks indicate end of records, and are ignored
 
+    // presets refer to instruments and samples, which must be read first
+    if (shdr.size() < 2) {
+        throw std::runtime_error("no sample found");
+    }
+    samples_.reserve(shdr.size() - 1);
+    for (auto it_shdr = shdr.begin(); it_shdr != std::prev(shdr.end()); ++it_shdr) {
+        if (mappedFile_) {
+            samples_.emplace_back(*it_shdr, sampleData_, sampleDataSize_, false);
+        } else {
+            // skip leading guard points
+            sf::Sample header = *it_shdr;
+            header.start += interp::GUARD_POINTS;
+            header.end += interp::GUARD_POINTS;
+            header.startloop += interp::GUARD_POINTS;
+            header.endloop += interp::GUARD_POINTS;
+            samples_.emplace_back(header, sampleData_, sampleDataSize_, true);
+        }
+    }
+    if (mappedFile_) {
+        addMappedCopies();
+    } else {
+        addLoopSeams();
+    }
+
     if (inst.size() < 2) {
         throw std::runtime_error("no instrument found");
     }
@@ -642,13 +742,87 @@ void SoundFont::readPdtaChunk(std::ifstream& ifs, std::size_t size) {
     for (auto it_phdr = phdr.begin(); it_phdr != std::prev(phdr.end()); ++it_phdr) {
         presets_.emplace_back(std::make_shared<Preset>(it_phdr, pbag, pmod, pgen, *this));
     }
+}
 
-    if (shdr.size() < 2) {
-        throw std::runtime_error("no sample found");
+static constexpr std::size_t SEAM_SIZE = 4 * interp::GUARD_POINTS;
+
+bool hasValidLoop(const Sample& sample) {
+    return sample.startLoop < sample.endLoop && sample.endLoop <= sample.bufferSize;
+}
+
+// appends points around loop end of sample to buffer, which must have enough capacity if it holds the sample
+void appendLoopSeam(const Sample& sample, std::vector<std::int16_t>& buffer) {
+    const std::int64_t loopLength = sample.endLoop - sample.startLoop;
+    for (std::size_t i = 0; i < SEAM_SIZE; ++i) {
+        // position relative to loop start, wrapped into the loop
+        const auto position = loopLength - static_cast<std::int64_t>(SEAM_SIZE / 2) + static_cast<std::int64_t>(i);
+        const auto wrapped = static_cast<std::size_t>((position % loopLength + loopLength) % loopLength);
+        buffer.push_back(sample.buffer[sample.startLoop + wrapped]);
     }
-    samples_.reserve(shdr.size() - 1);
-    for (auto it_shdr = shdr.begin(); it_shdr != std::prev(shdr.end()); ++it_shdr) {
-        samples_.emplace_back(*it_shdr, sampleBuffer_);
+}
+
+// loops are read across their end without wrapping positions back in interpolation
+void SoundFont::addLoopSeams() {
+    sampleBuffer_.reserve(sampleBuffer_.size() + SEAM_SIZE * samples_.size());
+    sampleData_ = sampleBuffer_.data();
+    for (Sample& sample : samples_) {
+        sample.buffer = sampleData_;
+        if (hasValidLoop(sample)) {
+            sample.seamBuffer = sampleData_;
+            sample.loopSeam = sampleBuffer_.size();
+            appendLoopSeam(sample, sampleBuffer_);
+        }
+    }
+}
+
+// memory-mapped data is not surrounded by guard points, so samples within guard points of either end of it are
+// copied with silent guard points as if loaded
+// loop seams cannot be appended to the data either, and are copied separately
+void SoundFont::addMappedCopies() {
+    static constexpr std::size_t GUARD = interp::GUARD_POINTS;
+    const auto isNearEnd = [this](const Sample& sample) {
+        return sample.start < sample.end && sample.end <= sampleDataSize_ &&
+               (sample.start < GUARD || sample.end + GUARD > sampleDataSize_);
+    };
+    // data in [first, last) is copied, which includes guard points of the data itself unless near its end
+    const auto getFirst = [](const Sample& sample) { return sample.start < GUARD ? 0 : sample.start - GUARD; };
+    const auto getLast = [this](const Sample& sample) { return std::min(sampleDataSize_, sample.end + GUARD); };
+
+    // pointers into sampleBuffer_ stay valid as it is never reallocated
+    std::size_t size = 0;
+    for (const Sample& sample : samples_) {
+        if (isNearEnd(sample)) {
+            size += getLast(sample) - getFirst(sample) + 2 * GUARD;
+        }
+        size += SEAM_SIZE;
+    }
+    sampleBuffer_.reserve(size);
+
+    for (Sample& sample : samples_) {
+        if (isNearEnd(sample)) {
+            const std::size_t first = getFirst(sample);
+            const std::size_t last = getLast(sample);
+            const std::size_t offset = sampleBuffer_.size();
+            sampleBuffer_.insert(sampleBuffer_.end(), GUARD, 0);
+            sampleBuffer_.insert(sampleBuffer_.end(), sampleData_ + first, sampleData_ + last);
+            sampleBuffer_.insert(sampleBuffer_.end(), GUARD, 0);
+
+            // loop points before the copy are moved to its beginning, where voices clamp them to start
+            const auto shift = [first](std::uint32_t position) {
+                return static_cast<std::uint32_t>(position < first ? 0 : position - first + GUARD);
+            };
+            sample.start = shift(sample.start);
+            sample.end = shift(sample.end);
+            sample.startLoop = shift(sample.startLoop);
+            sample.endLoop = shift(sample.endLoop);
+            sample.buffer = sampleBuffer_.data() + offset;
+            sample.bufferSize = sampleBuffer_.size() - offset;
+        }
+        if (hasValidLoop(sample)) {
+            sample.seamBuffer = sampleBuffer_.data();
+            sample.loopSeam = sampleBuffer_.size();
+            appendLoopSeam(sample, sampleBuffer_);
+        }
     }
 }
 }
@@ -1,39 +1,242 @@
 #include "synthesizer.h"
+#include <stdexcept>
 
 namespace primesynth {
-Synthesizer::Synthesizer(double outputRate, std::size_t numChannels)
-    : volume_(1.0), midiStd_(midi::Standard::GM), defaultMIDIStd_(midi::Standard::GM), stdFixed_(false) {
-    conv::initialize();
+// maximum number of frames rendered by channels at once
+static constexpr std::size_t MAX_BLOCK_SIZE = 256;
+static constexpr std::size_t DEFAULT_POLYPHONY = 256;
+static constexpr std::size_t EVENT_QUEUE_SIZE = 1 << 12;
+// number of banks and presets selectable by MIDI messages, excluding percussion bank
+static constexpr std::uint16_t NUM_MIDI_BANKS = 128;
+static constexpr std::uint16_t NUM_MIDI_PRESETS = 128;
+
+std::uint32_t toPresetKey(std::uint16_t bank, std::uint16_t presetID) {
+    return static_cast<std::uint32_t>(bank) << 16 | presetID;
+}
 
+Synthesizer::Synthesizer(double outputRate, std::size_t numChannels)
+    : outputRate_(outputRate),
+      midiStd_(midi::Standard::GM),
+      defaultMIDIStd_(midi::Standard::GM),
+      stdFixed_(false),
+      volume_(1.0),
+      polyphony_(DEFAULT_POLYPHONY),
+      stealingPolicy_(StealingPolicy::OldestReleased),
+      leftBuffer_(MAX_BLOCK_SIZE),
+      rightBuffer_(MAX_BLOCK_SIZE),
+      channelBuffers_(2 * MAX_BLOCK_SIZE * numChannels),
+      eventQueue_(EVENT_QUEUE_SIZE),
+      currentFrame_(0),
+      largestBlockSize_(0) {
     channels_.reserve(numChannels);
     for (std::size_t i = 0; i < numChannels; ++i) {
         channels_.emplace_back(std::make_unique<Channel>(outputRate));
     }
 }
 
-StereoValue Synthesizer::render() const {
-    StereoValue sum{0.0, 0.0};
-    for (const auto& channel : channels_) {
-        sum += channel->render();
+void Synthesizer::renderBlock(float* left, float* right, std::size_t numFrames) {
+    if (numFrames > largestBlockSize_.load(std::memory_order_relaxed)) {
+        largestBlockSize_.store(numFrames, std::memory_order_relaxed);
+    }
+    const auto volume = static_cast<float>(volume_);
+    for (std::size_t offset = 0; offset < numFrames;) {
+        const std::size_t segmentSize = renderSegment(numFrames - offset);
+        for (std::size_t i = 0; i < segmentSize; ++i) {
+            left[offset + i] = volume * leftBuffer_[i];
+            right[offset + i] = volume * rightBuffer_[i];
+        }
+        offset += segmentSize;
+    }
+}
+
+void Synthesizer::renderBlock(float* buffer, std::size_t numFrames) {
+    if (numFrames > largestBlockSize_.load(std::memory_order_relaxed)) {
+        largestBlockSize_.store(numFrames, std::memory_order_relaxed);
+    }
+    const auto volume = static_cast<float>(volume_);
+    for (std::size_t offset = 0; offset < numFrames;) {
+        const std::size_t segmentSize = renderSegment(numFrames - offset);
+        for (std::size_t i = 0; i < segmentSize; ++i) {
+            buffer[2 * (offset + i)] = volume * leftBuffer_[i];
+            buffer[2 * (offset + i) + 1] = volume * rightBuffer_[i];
+        }
+        offset += segmentSize;
     }
-    return volume_ * sum;
 }
 
-void Synthesizer::loadSoundFont(const std::string& filename) {
-    soundFonts_.emplace_back(std::make_unique<SoundFont>(filename));
+double Synthesizer::getSampleRate() const {
+    return outputRate_;
+}
+
+std::uint64_t Synthesizer::getCurrentFrame() const {
+    return currentFrame_.load(std::memory_order_relaxed);
+}
+
+std::size_t Synthesizer::getLargestBlockSize() const {
+    return largestBlockSize_.load(std::memory_order_relaxed);
+}
+
+void Synthesizer::loadSoundFont(const std::string& filename, bool memoryMapped) {
+    soundFonts_.emplace_back(std::make_unique<SoundFont>(filename, memoryMapped));
+    updatePresetIndex();
 }
 
 void Synthesizer::setVolume(double volume) {
     volume_ = std::max(0.0, volume);
 }
 
+void Synthesizer::setInterpolation(interp::Mode interpolation) {
+    for (const auto& channel : channels_) {
+        channel->setInterpolation(interpolation);
+    }
+}
+
+void Synthesizer::setCalcInterval(unsigned int interval) {
+    if (!isValidCalcInterval(interval)) {
+        throw std::invalid_argument("control interval must be 16, 32, 64 or 128");
+    }
+    for (const auto& channel : channels_) {
+        channel->setCalcInterval(interval);
+    }
+}
+
+void Synthesizer::setPolyphony(std::size_t polyphony) {
+    polyphony_ = polyphony;
+}
+
+void Synthesizer::setStealingPolicy(StealingPolicy policy) {
+    stealingPolicy_ = policy;
+}
+
+void Synthesizer::setChannelPriority(std::size_t channel, int priority) {
+    channels_.at(channel)->setPriority(priority);
+}
+
+void Synthesizer::setNumThreads(std::size_t numThreads) {
+    if (numThreads > 1) {
+        threadPool_ = std::make_unique<ThreadPool>(numThreads);
+    } else {
+        threadPool_.reset();
+    }
+}
+
 void Synthesizer::setMIDIStandard(midi::Standard midiStandard, bool fixed) {
     midiStd_ = midiStandard;
     defaultMIDIStd_ = midiStandard;
     stdFixed_ = fixed;
 }
 
-void Synthesizer::processShortMessage(std::uint32_t param) {
+// applies events due by current frame and renders until next event or end of block
+// returns number of frames rendered into leftBuffer_ and rightBuffer_
+std::size_t Synthesizer::renderSegment(std::size_t maxFrames) {
+    const std::uint64_t currentFrame = currentFrame_.load(std::memory_order_relaxed);
+    std::size_t numFrames = std::min(maxFrames, MAX_BLOCK_SIZE);
+    while (const MIDIEvent* event = eventQueue_.front()) {
+        if (event->frame > currentFrame) {
+            numFrames = static_cast<std::size_t>(std::min<std::uint64_t>(numFrames, event->frame - currentFrame));
+            break;
+        }
+        switch (event->type) {
+        case MIDIEvent::Type::ShortMessage:
+            handleShortMessage(event->param);
+            break;
+        case MIDIEvent::Type::SysEx:
+            handleSysEx(event->sysEx.data(), event->sysExLength);
+            break;
+        }
+        eventQueue_.pop();
+    }
+
+    renderChannels(numFrames);
+    // voices which could not be stolen before they were rendered
+    limitPolyphony();
+    currentFrame_.store(currentFrame + numFrames, std::memory_order_relaxed);
+    return numFrames;
+}
+
+void Synthesizer::renderChannels(std::size_t numFrames) {
+    // each channel renders into its own buffer so that channels can be rendered on any thread
+    auto renderChannel = [this, numFrames](std::size_t i) {
+        float* left = &channelBuffers_.at(2 * MAX_BLOCK_SIZE * i);
+        float* right = left + MAX_BLOCK_SIZE;
+        std::fill_n(left, numFrames, 0.0f);
+        std::fill_n(right, numFrames, 0.0f);
+        channels_.at(i)->render(left, right, numFrames);
+    };
+    if (threadPool_) {
+        threadPool_->run(channels_.size(), renderChannel);
+    } else {
+        for (std::size_t i = 0; i < channels_.size(); ++i) {
+            renderChannel(i);
+        }
+    }
+
+    // mix in fixed order so that output does not depend on number of threads
+    std::fill_n(leftBuffer_.begin(), numFrames, 0.0f);
+    std::fill_n(rightBuffer_.begin(), numFrames, 0.0f);
+    for (std::size_t i = 0; i < channels_.size(); ++i) {
+        const float* left = &channelBuffers_.at(2 * MAX_BLOCK_SIZE * i);
+        const float* right = left + MAX_BLOCK_SIZE;
+        for (std::size_t j = 0; j < numFrames; ++j) {
+            leftBuffer_[j] += left[j];
+            rightBuffer_[j] += right[j];
+        }
+    }
+}
+
+std::size_t Synthesizer::countVoices() const {
+    std::size_t numVoices = 0;
+    for (const auto& channel : channels_) {
+        numVoices += channel->getNumVoices();
+    }
+    return numVoices;
+}
+
+// steals voices until number of voices fits in polyphony
+// each steal costs O(number of channels) regardless of number of voices
+void Synthesizer::limitPolyphony() {
+    while (countVoices() > polyphony_) {
+        Channel* victim = nullptr;
+        VictimRank victimRank{};
+        for (const auto& channel : channels_) {
+            VictimRank rank;
+            if (channel->findVictim(stealingPolicy_, rank) && (!victim || victimRank < rank)) {
+                victim = channel.get();
+                victimRank = rank;
+            }
+        }
+        if (!victim || !victim->stealVoice(stealingPolicy_)) {
+            // remaining voices have just started, let them exceed polyphony until they are rendered
+            break;
+        }
+    }
+}
+
+bool Synthesizer::processShortMessage(std::uint32_t param, std::uint64_t frame) {
+    MIDIEvent event;
+    event.frame = frame;
+    event.type = MIDIEvent::Type::ShortMessage;
+    event.param = param;
+    return eventQueue_.push(event);
+}
+
+bool Synthesizer::processSysEx(const char* data, std::size_t length, std::uint64_t frame) {
+    if (length > MIDIEvent::MAX_SYSEX_LENGTH) {
+        return false;
+    }
+    MIDIEvent event;
+    event.frame = frame;
+    event.type = MIDIEvent::Type::SysEx;
+    event.sysExLength = static_cast<std::uint8_t>(length);
+    std::copy_n(data, length, event.sysEx.begin());
+    return eventQueue_.push(event);
+}
+
+std::size_t Synthesizer::processEvents(const MIDIEvent* events, std::size_t count) {
+    return eventQueue_.write(events, count);
+}
+
+void Synthesizer::handleShortMessage(std::uint32_t param) {
     const auto msg = reinterpret_cast<std::uint8_t*>(&param);
     const auto status = msg[0] & 0xf0;
     if (status != 0xf0) {
@@ -58,7 +261,7 @@ bool matchSysEx(const char* data, std::size_t length, const std::array<unsigned
     return true;
 }
 
-void Synthesizer::processSysEx(const char* data, std::size_t length) {
+void Synthesizer::handleSysEx(const char* data, std::size_t length) {
     static constexpr std::array<unsigned char, 6> GM_SYSTEM_ON = {0xf0, 0x7e, 0, 0x09, 0x01, 0xf7};
     static constexpr std::array<unsigned char, 6> GM_SYSTEM_OFF = {0xf0, 0x7e, 0, 0x09, 0x02, 0xf7};
     static constexpr std::array<unsigned char, 11> GS_RESET = {0xf0, 0x41, 0,    0x42, 0x12, 0x40,
@@ -84,31 +287,56 @@ void Synthesizer::processSysEx(const char* data, std::size_t length) {
     }
 }
 
-std::shared_ptr<const Preset> Synthesizer::findPreset(std::uint16_t bank, std::uint16_t presetID) const {
+void Synthesizer::updatePresetIndex() {
+    presetIndex_.clear();
+    presetIndex_.reserve((NUM_MIDI_BANKS + 1) * NUM_MIDI_PRESETS);
+
+    // presets in SoundFonts loaded earlier take priority
     for (const auto& sf : soundFonts_) {
         for (const auto& preset : sf->getPresetPtrs()) {
-            if (preset->bank == bank && preset->presetID == presetID) {
-                return preset;
-            }
+            presetIndex_.emplace(toPresetKey(preset->bank, preset->presetID), preset);
         }
     }
 
-    // fallback
-    if (bank == PERCUSSION_BANK) {
-        if (presetID != 0) {
+    const auto find = [this](std::uint16_t bank, std::uint16_t presetID) -> std::shared_ptr<const Preset> {
+        const auto it = presetIndex_.find(toPresetKey(bank, presetID));
+        return it != presetIndex_.end() ? it->second : nullptr;
+    };
+
+    // resolve fallbacks of all presets selectable by MIDI messages
+    // GM bank is resolved first so that other banks can fall back to it
+    if (const auto piano = find(0, 0)) {
+        for (std::uint16_t presetID = 0; presetID < NUM_MIDI_PRESETS; ++presetID) {
+            // preset not found even in GM bank, fall back to Piano
+            presetIndex_.emplace(toPresetKey(0, presetID), piano);
+        }
+    }
+    if (const auto percussion = find(PERCUSSION_BANK, 0)) {
+        for (std::uint16_t presetID = 0; presetID < NUM_MIDI_PRESETS; ++presetID) {
             // fall back to GM percussion
-            return findPreset(bank, 0);
-        } else {
-            throw std::runtime_error("failed to find preset 128:0 (GM Percussion)");
+            presetIndex_.emplace(toPresetKey(PERCUSSION_BANK, presetID), percussion);
+        }
+    }
+    for (std::uint16_t presetID = 0; presetID < NUM_MIDI_PRESETS; ++presetID) {
+        if (const auto gmPreset = find(0, presetID)) {
+            for (std::uint16_t bank = 1; bank < NUM_MIDI_BANKS; ++bank) {
+                // fall back to GM bank
+                presetIndex_.emplace(toPresetKey(bank, presetID), gmPreset);
+            }
         }
-    } else if (bank != 0) {
-        // fall back to GM bank
-        return findPreset(0, presetID);
-    } else if (presetID != 0) {
-        // preset not found even in GM bank, fall back to Piano
-        return findPreset(0, 0);
+    }
+}
+
+std::shared_ptr<const Preset> Synthesizer::findPreset(std::uint16_t bank, std::uint16_t presetID) const {
+    const auto it = presetIndex_.find(toPresetKey(bank, presetID));
+    if (it != presetIndex_.end()) {
+        return it->second;
+    }
+
+    // there is no more fallback
+    if (bank == PERCUSSION_BANK) {
+        throw std::runtime_error("failed to find preset 128:0 (GM Percussion)");
     } else {
-        // Piano not found, there is no more fallback
         throw std::runtime_error("failed to find preset 0:0 (GM Acoustic Grand Piano)");
     }
 }
@@ -133,6 +361,7 @@ void Synthesizer::processChannelMessage(unsigned long param) {
                                                                      : findPreset(0, 0));
         }
         channel->noteOn(msg[1], msg[2]);
+        limitPolyphony();
         break;
     case midi::MessageStatus::KeyPressure:
         channel->keyPressure(msg[1], msg[2]);
@@ -0,0 +1,124 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace primesynth {
+static std::uint64_t packRange(std::uint32_t begin, std::uint32_t end) {
+    return static_cast<std::uint64_t>(end) << 32 | begin;
+}
+
+ThreadPool::ThreadPool(std::size_t numThreads)
+    : workers_(std::make_unique<Worker[]>(std::max<std::size_t>(numThreads, 1))),
+      numThreads_(std::max<std::size_t>(numThreads, 1)),
+      taskFunc_(nullptr),
+      task_(nullptr),
+      pending_(0),
+      generation_(0),
+      stopping_(false) {
+    threads_.reserve(numThreads_ - 1);
+    for (std::size_t i = 1; i < numThreads_; ++i) {
+        threads_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+std::size_t ThreadPool::getNumThreads() const {
+    return numThreads_;
+}
+
+void ThreadPool::dispatch(std::size_t numTasks, TaskFunction func, void* task) {
+    if (numTasks == 0) {
+        return;
+    }
+
+    taskFunc_ = func;
+    task_ = task;
+    pending_.store(numTasks, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < numThreads_; ++i) {
+        const auto begin = static_cast<std::uint32_t>(numTasks * i / numThreads_);
+        const auto end = static_cast<std::uint32_t>(numTasks * (i + 1) / numThreads_);
+        workers_[i].range.store(packRange(begin, end), std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> lockGuard(mutex_);
+        ++generation_;
+    }
+    cv_.notify_all();
+
+    work(0);
+    while (pending_.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+void ThreadPool::workerLoop(std::size_t id) {
+    std::uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [&] { return stopping_ || generation_ != seenGeneration; });
+            if (stopping_) {
+                return;
+            }
+            seenGeneration = generation_;
+        }
+        work(id);
+    }
+}
+
+void ThreadPool::work(std::size_t id) {
+    std::size_t index;
+    while (popTask(id, index)) {
+        taskFunc_(task_, index);
+        pending_.fetch_sub(1, std::memory_order_release);
+    }
+    for (std::size_t i = 1; i < numThreads_; ++i) {
+        const std::size_t victim = (id + i) % numThreads_;
+        while (stealTask(victim, index)) {
+            taskFunc_(task_, index);
+            pending_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+bool ThreadPool::popTask(std::size_t worker, std::size_t& index) {
+    auto& range = workers_[worker].range;
+    std::uint64_t r = range.load(std::memory_order_acquire);
+    while (true) {
+        const auto begin = static_cast<std::uint32_t>(r);
+        const auto end = static_cast<std::uint32_t>(r >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        if (range.compare_exchange_weak(r, packRange(begin + 1, end), std::memory_order_acq_rel)) {
+            index = begin;
+            return true;
+        }
+    }
+}
+
+bool ThreadPool::stealTask(std::size_t worker, std::size_t& index) {
+    auto& range = workers_[worker].range;
+    std::uint64_t r = range.load(std::memory_order_acquire);
+    while (true) {
+        const auto begin = static_cast<std::uint32_t>(r);
+        const auto end = static_cast<std::uint32_t>(r >> 32);
+        if (begin >= end) {
+            return false;
+        }
+        if (range.compare_exchange_weak(r, packRange(begin, end - 1), std::memory_order_acq_rel)) {
+            index = end - 1;
+            return true;
+        }
+    }
+}
+}
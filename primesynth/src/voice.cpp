@@ -1,31 +1,38 @@
 #include "voice.h"
+#include <algorithm>
 
 namespace primesynth {
-static constexpr unsigned int CALC_INTERVAL = 64;
-
 // for compatibility
 static constexpr double ATTEN_FACTOR = 0.4;
 
-Voice::Voice(std::size_t noteID, double outputRate, const Sample& sample, const GeneratorSet& generators,
-             const ModulatorParameterSet& modparams, std::uint8_t key, std::uint8_t velocity)
+bool isValidCalcInterval(unsigned int interval) {
+    return interval == 16 || interval == 32 || interval == 64 || interval == 128;
+}
+
+Voice::Voice(ControlEngine& control, std::size_t slot, std::size_t noteID, double outputRate, const Sample& sample,
+             const GeneratorSet& generators, const ModulatorRouting& modulatorRouting, std::uint8_t key,
+             std::uint8_t velocity)
     : noteID_(noteID),
+      actualKey_(key),
       sampleBuffer_(sample.buffer),
       generators_(generators),
-      actualKey_(key),
+      modulatorRouting_(modulatorRouting),
       percussion_(false),
       fineTuning_(0.0),
       coarseTuning_(0.0),
       steps_(0),
+      releasedSteps_(0),
       status_(State::Playing),
-      index_(sample.start),
+      index_(0u),
       deltaIndex_(0u),
       volume_({1.0, 1.0}),
       amp_(0.0),
       deltaAmp_(0.0),
-      volEnv_(outputRate, CALC_INTERVAL),
-      modEnv_(outputRate, CALC_INTERVAL),
-      vibLFO_(outputRate, CALC_INTERVAL),
-      modLFO_(outputRate, CALC_INTERVAL) {
+      fadeFrames_(0),
+      control_(control),
+      slot_(slot) {
+    control_.reset(slot_);
+
     rtSample_.mode = static_cast<SampleMode>(0b11 & generators.getOrDefault(sf::Generator::SampleModes));
     const std::int16_t overriddenSampleKey = generators.getOrDefault(sf::Generator::OverridingRootKey);
     rtSample_.pitch = (overriddenSampleKey > 0 ? overriddenSampleKey : sample.key) - 0.01 * sample.correction;
@@ -43,18 +50,30 @@ Voice::Voice(std::size_t noteID, double outputRate, const Sample& sample, const
                         generators.getOrDefault(sf::Generator::EndloopAddrsOffset);
 
     // fix invalid sample range
-    const auto bufferSize = static_cast<std::uint32_t>(sample.buffer.size());
-    rtSample_.start = std::min(bufferSize - 1, rtSample_.start);
-    rtSample_.end = std::max(rtSample_.start + 1, std::min(bufferSize, rtSample_.end));
+    // interpolation reads guard points around played positions without bounds checks
+    const auto first = static_cast<std::uint32_t>(interp::GUARD_POINTS);
+    const auto last = static_cast<std::uint32_t>(sample.bufferSize - interp::GUARD_POINTS);
+    rtSample_.start = std::max(first, std::min(last - 1, rtSample_.start));
+    rtSample_.end = std::max(rtSample_.start + 1, std::min(last, rtSample_.end));
     rtSample_.startLoop = std::max(rtSample_.start, std::min(rtSample_.end - 1, rtSample_.startLoop));
     rtSample_.endLoop = std::max(rtSample_.startLoop + 1, std::min(rtSample_.end, rtSample_.endLoop));
+    index_ = FixedPoint(rtSample_.start);
+
+    // loop seam of sample is valid only if loop is not moved by generators
+    const auto seamWidth = static_cast<std::uint32_t>(interp::GUARD_POINTS);
+    if (sample.seamBuffer && rtSample_.startLoop == sample.startLoop && rtSample_.endLoop == sample.endLoop) {
+        rtSample_.seamBegin = rtSample_.endLoop - seamWidth;
+        rtSample_.seamEnd = rtSample_.endLoop + seamWidth;
+        rtSample_.seamOffset = static_cast<std::uint32_t>(sample.loopSeam) + 2 * seamWidth - rtSample_.endLoop;
+        rtSample_.seamBuffer = sample.seamBuffer;
+    } else {
+        rtSample_.seamBegin = rtSample_.seamEnd = rtSample_.endLoop;
+        rtSample_.seamOffset = 0;
+        rtSample_.seamBuffer = sampleBuffer_;
+    }
 
     deltaIndexRatio_ = 1.0 / conv::keyToHertz(rtSample_.pitch) * sample.sampleRate / outputRate;
 
-    for (const auto& mp : modparams.getParameters()) {
-        modulators_.emplace_back(mp);
-    }
-
     const std::int16_t genVelocity = generators.getOrDefault(sf::Generator::Velocity);
     updateSFController(sf::GeneralController::NoteOnVelocity, genVelocity > 0 ? genVelocity : velocity);
 
@@ -64,15 +83,16 @@ Voice::Voice(std::size_t noteID, double outputRate, const Sample& sample, const
     updateSFController(sf::GeneralController::NoteOnKeyNumber, overriddenKey);
 
     double minModulatedAtten = ATTEN_FACTOR * generators_.getOrDefault(sf::Generator::InitialAttenuation);
-    for (const auto& mod : modulators_) {
-        if (mod.getDestination() == sf::Generator::InitialAttenuation && mod.canBeNegative()) {
+    for (auto it = modulatorRouting_.beginDestination(sf::Generator::InitialAttenuation);
+         it != modulatorRouting_.endDestination(sf::Generator::InitialAttenuation); ++it) {
+        if (modulatorRouting_.canBeNegative(*it)) {
             // mod may increase volume
-            minModulatedAtten -= std::abs(mod.getAmount());
+            minModulatedAtten -= std::abs(modulatorRouting_.getModulator(*it).param.modAmount);
         }
     }
     minAtten_ = sample.minAtten + std::max(0.0, minModulatedAtten);
 
-    for (int i = 0; i < NUM_GENERATORS; ++i) {
+    for (std::size_t i = 0; i < NUM_GENERATORS; ++i) {
         modulated_.at(i) = generators.getOrDefault(static_cast<sf::Generator>(i));
     }
     static const auto INIT_GENERATORS = {
@@ -103,11 +123,18 @@ const Voice::State& Voice::getStatus() const {
     return status_;
 }
 
-StereoValue Voice::render() const {
-    const std::uint32_t i = index_.getIntegerPart();
-    const double r = index_.getFractionalPart();
-    const double interpolated = (1.0 - r) * sampleBuffer_.at(i) + r * sampleBuffer_.at(i + 1);
-    return amp_ * volume_ * (interpolated / INT16_MAX);
+unsigned int Voice::getAge() const {
+    return steps_;
+}
+
+unsigned int Voice::getReleaseAge() const {
+    return steps_ - releasedSteps_;
+}
+
+double Voice::getLoudness() const {
+    // rate voices by their peak until they reach it, so that they are not stolen just after note-on
+    const double amp = control_.volEnvs.getPhase(slot_) <= EnvelopeBank::Phase::Attack ? 1.0 : amp_;
+    return amp * std::max(volume_.left, volume_.right);
 }
 
 void Voice::setPercussion(bool percussion) {
@@ -115,19 +142,34 @@ void Voice::setPercussion(bool percussion) {
 }
 
 void Voice::updateSFController(sf::GeneralController controller, double value) {
-    for (auto& mod : modulators_) {
-        if (mod.updateSFController(controller, value)) {
-            updateModulatedParams(mod.getDestination());
-        }
+    const auto& route = modulatorRouting_.getRoute(controller);
+    for (const std::uint8_t i : route.modulators) {
+        modulators_[i].updateSFController(modulatorRouting_.getModulator(i), controller, value);
+    }
+    for (const sf::Generator destination : route.destinations) {
+        updateModulatedParams(destination);
     }
 }
 
 void Voice::updateMIDIController(std::uint8_t controller, std::uint8_t value) {
-    for (auto& mod : modulators_) {
-        if (mod.updateMIDIController(controller, value)) {
-            updateModulatedParams(mod.getDestination());
+    const auto& route = modulatorRouting_.getRoute(controller);
+    for (const std::uint8_t i : route.modulators) {
+        modulators_[i].updateMIDIController(modulatorRouting_.getModulator(i), controller, value);
+    }
+    for (const sf::Generator destination : route.destinations) {
+        updateModulatedParams(destination);
+    }
+}
+
+void Voice::updateMIDIControllers(const std::array<std::uint8_t, midi::NUM_CONTROLLERS>& values) {
+    for (const std::uint8_t controller : modulatorRouting_.getMIDIControllers()) {
+        for (const std::uint8_t i : modulatorRouting_.getRoute(controller).modulators) {
+            modulators_[i].updateMIDIController(modulatorRouting_.getModulator(i), controller, values.at(controller));
         }
     }
+    for (const sf::Generator destination : modulatorRouting_.getMIDIDestinations()) {
+        updateModulatedParams(destination);
+    }
 }
 
 void Voice::updateFineTuning(double fineTuning) {
@@ -157,77 +199,153 @@ void Voice::release(bool sustained) {
         status_ = State::Sustained;
     } else {
         status_ = State::Released;
-        volEnv_.release();
-        modEnv_.release();
+        releasedSteps_ = steps_;
+        if (rtSample_.mode == SampleMode::LoopedUntilRelease) {
+            // index may be past loop end, where it is read from loop seam or has not wrapped yet
+            const FixedPoint loopLength(rtSample_.endLoop - rtSample_.startLoop);
+            while (index_.getIntegerPart() >= rtSample_.endLoop) {
+                index_ -= loopLength;
+            }
+        }
+        control_.volEnvs.release(slot_);
+        control_.modEnvs.release(slot_);
     }
 }
 
-void Voice::update() {
-    const bool calc = steps_++ % CALC_INTERVAL == 0;
+void Voice::steal(std::size_t numFrames) {
+    if (status_ == State::Finished) {
+        return;
+    }
+    status_ = State::Stolen;
+    fadeFrames_ = std::max<std::size_t>(numFrames, 1);
+    deltaAmp_ = -amp_ / fadeFrames_;
+}
 
-    if (calc) {
-        // dynamic range of signed 16 bit samples in centibel
-        static const double DYNAMIC_RANGE = 200.0 * std::log10(INT16_MAX + 1.0);
-        if (volEnv_.getPhase() == Envelope::Phase::Finished ||
-            (volEnv_.getPhase() > Envelope::Phase::Attack &&
-             minAtten_ + 960.0 * (1.0 - volEnv_.getValue()) >= DYNAMIC_RANGE)) {
-            status_ = State::Finished;
-            return;
-        }
+bool Voice::prepareUpdate() {
+    // dynamic range of signed 16 bit samples in centibel
+    static const double DYNAMIC_RANGE = 200.0 * std::log10(INT16_MAX + 1.0);
+    const EnvelopeBank& volEnvs = control_.volEnvs;
+    if (volEnvs.getPhase(slot_) == EnvelopeBank::Phase::Finished ||
+        (volEnvs.getPhase(slot_) > EnvelopeBank::Phase::Attack &&
+         minAtten_ + 960.0 * (1.0 - volEnvs.getValue(slot_)) >= DYNAMIC_RANGE)) {
+        status_ = State::Finished;
+        return false;
+    }
+    return true;
+}
 
-        volEnv_.update();
+void Voice::update(std::size_t numFrames) {
+    const EnvelopeBank::Phase volEnvPhase = control_.volEnvs.getPhase(slot_);
+    const double volEnvValue = control_.volEnvs.getValue(slot_);
+    const double modEnvValue = control_.modEnvs.getPhase(slot_) == EnvelopeBank::Phase::Attack
+                                   ? conv::convex(control_.modEnvs.getValue(slot_))
+                                   : control_.modEnvs.getValue(slot_);
+    const double vibLFOValue = control_.vibLFOs.getValue(slot_);
+    const double modLFOValue = control_.modLFOs.getValue(slot_);
+
+    const double pitch = voicePitch_ + 0.01 * (getModulatedGenerator(sf::Generator::ModEnvToPitch) * modEnvValue +
+                                               getModulatedGenerator(sf::Generator::VibLfoToPitch) * vibLFOValue +
+                                               getModulatedGenerator(sf::Generator::ModLfoToPitch) * modLFOValue);
+    deltaIndex_ = FixedPoint(deltaIndexRatio_ * conv::keyToHertz(pitch));
+
+    if (status_ == State::Stolen) {
+        // keep fading out
+        return;
+    }
+    const double attenModLFO = getModulatedGenerator(sf::Generator::ModLfoToVolume) * modLFOValue;
+    const double targetAmp = volEnvPhase == EnvelopeBank::Phase::Attack
+                                 ? volEnvValue * conv::attenuationToAmplitude(attenModLFO)
+                                 : conv::attenuationToAmplitude(960.0 * (1.0 - volEnvValue) + attenModLFO);
+    deltaAmp_ = (targetAmp - amp_) / numFrames;
+}
+
+void Voice::render(float* left, float* right, std::size_t numFrames, interp::Mode interpolation) {
+    if (status_ == State::Finished) {
+        return;
+    }
+    if (status_ == State::Stolen) {
+        numFrames = std::min(numFrames, fadeFrames_);
     }
 
-    index_ += deltaIndex_;
+    std::array<std::uint32_t, MAX_CALC_INTERVAL> indices, fractions;
+    // sample mode does not change while rendering, as voices are released only between renders
+    const bool looping = rtSample_.mode == SampleMode::Looped ||
+                         (rtSample_.mode == SampleMode::LoopedUntilRelease && status_ != State::Released);
+    std::size_t n = 0;
+    while (n < numFrames && status_ != State::Finished) {
+        // loop seam is in another buffer than the rest of sample if sample data is memory-mapped
+        const std::int16_t* buffer;
+        const std::size_t run =
+            looping ? advance<true>(indices.data(), fractions.data(), numFrames - n, buffer)
+                    : advance<false>(indices.data(), fractions.data(), numFrames - n, buffer);
+
+        const interp::Gain gain{static_cast<float>(amp_), static_cast<float>(deltaAmp_),
+                                static_cast<float>(volume_.left), static_cast<float>(volume_.right)};
+        interp::render(interpolation, buffer, {indices.data(), fractions.data()}, run, gain, left + n, right + n);
+        amp_ += run * deltaAmp_;
+        n += run;
+    }
+    steps_ += static_cast<unsigned int>(n);
 
-    switch (rtSample_.mode) {
-    case SampleMode::UnLooped:
-    case SampleMode::UnUsed:
-        if (index_.getIntegerPart() >= rtSample_.end) {
+    if (status_ == State::Stolen) {
+        fadeFrames_ -= n;
+        if (fadeFrames_ == 0) {
             status_ = State::Finished;
-            return;
-        }
-        break;
-    case SampleMode::Looped:
-        if (index_.getIntegerPart() >= rtSample_.endLoop) {
-            index_ -= FixedPoint(rtSample_.endLoop - rtSample_.startLoop);
         }
-        break;
-    case SampleMode::LoopedUntilRelease:
-        if (status_ == State::Released) {
-            if (index_.getIntegerPart() >= rtSample_.end) {
-                status_ = State::Finished;
-                return;
+    }
+}
+
+template <bool Looping>
+std::size_t Voice::advance(std::uint32_t* indices, std::uint32_t* fractions, std::size_t numFrames,
+                           const std::int16_t*& buffer) {
+    const std::uint64_t delta = deltaIndex_.getRaw();
+    const FixedPoint loopLength(rtSample_.endLoop - rtSample_.startLoop);
+
+    std::size_t n = 0;
+    while (n < numFrames) {
+        // voice finishes at end of sample, or index wraps around at end of seam while looping
+        std::uint32_t limit = rtSample_.end;
+        std::uint32_t offset = 0;
+        const std::int16_t* runBuffer = sampleBuffer_;
+        if (Looping) {
+            // a step can be longer than the loop
+            while (index_.getIntegerPart() >= rtSample_.seamEnd) {
+                index_ -= loopLength;
+            }
+            if (index_.getIntegerPart() < rtSample_.seamBegin) {
+                limit = rtSample_.seamBegin;
+            } else {
+                limit = rtSample_.seamEnd;
+                offset = rtSample_.seamOffset;
+                runBuffer = rtSample_.seamBuffer;
             }
-        } else if (index_.getIntegerPart() >= rtSample_.endLoop) {
-            index_ -= FixedPoint(rtSample_.endLoop - rtSample_.startLoop);
         }
-        break;
-    default:
-        throw std::runtime_error("unknown sample mode");
-    }
+        if (n == 0) {
+            buffer = runBuffer;
+        } else if (runBuffer != buffer) {
+            break;
+        }
+
+        // number of frames until index reaches limit, at least one
+        const std::uint64_t boundary = FixedPoint(limit).getRaw();
+        std::size_t run = numFrames - n;
+        if (delta > 0) {
+            const std::uint64_t steps = (boundary - index_.getRaw() + delta - 1) / delta;
+            run = static_cast<std::size_t>(std::min<std::uint64_t>(run, steps));
+        }
 
-    amp_ += deltaAmp_;
-
-    if (calc) {
-        modEnv_.update();
-        vibLFO_.update();
-        modLFO_.update();
-
-        const double modEnvValue =
-            modEnv_.getPhase() == Envelope::Phase::Attack ? conv::convex(modEnv_.getValue()) : modEnv_.getValue();
-        const double pitch =
-            voicePitch_ + 0.01 * (getModulatedGenerator(sf::Generator::ModEnvToPitch) * modEnvValue +
-                                  getModulatedGenerator(sf::Generator::VibLfoToPitch) * vibLFO_.getValue() +
-                                  getModulatedGenerator(sf::Generator::ModLfoToPitch) * modLFO_.getValue());
-        deltaIndex_ = FixedPoint(deltaIndexRatio_ * conv::keyToHertz(pitch));
-
-        const double attenModLFO = getModulatedGenerator(sf::Generator::ModLfoToVolume) * modLFO_.getValue();
-        const double targetAmp = volEnv_.getPhase() == Envelope::Phase::Attack
-                                     ? volEnv_.getValue() * conv::attenuationToAmplitude(attenModLFO)
-                                     : conv::attenuationToAmplitude(960.0 * (1.0 - volEnv_.getValue()) + attenModLFO);
-        deltaAmp_ = (targetAmp - amp_) / CALC_INTERVAL;
+        for (const std::size_t end = n + run; n < end; ++n) {
+            indices[n] = index_.getIntegerPart() + offset;
+            fractions[n] = index_.getRawFractionalPart();
+            index_ += deltaIndex_;
+        }
+
+        if (!Looping && index_.getRaw() >= boundary) {
+            status_ = State::Finished;
+            break;
+        }
     }
+    return n;
 }
 
 double Voice::getModulatedGenerator(sf::Generator type) const {
@@ -251,10 +369,9 @@ void Voice::updateModulatedParams(sf::Generator destination) {
     if (destination == sf::Generator::InitialAttenuation) {
         modulated *= ATTEN_FACTOR;
     }
-    for (const auto& mod : modulators_) {
-        if (mod.getDestination() == destination) {
-            modulated += mod.getValue();
-        }
+    for (auto it = modulatorRouting_.beginDestination(destination); it != modulatorRouting_.endDestination(destination);
+         ++it) {
+        modulated += modulators_[*it].getValue();
     }
 
     switch (destination) {
@@ -264,64 +381,64 @@ void Voice::updateModulatedParams(sf::Generator destination) {
                   calculatePannedVolume(getModulatedGenerator(sf::Generator::Pan));
         break;
     case sf::Generator::DelayModLFO:
-        modLFO_.setDelay(modulated);
+        control_.modLFOs.setDelay(slot_, modulated);
         break;
     case sf::Generator::FreqModLFO:
-        modLFO_.setFrequency(modulated);
+        control_.modLFOs.setFrequency(slot_, modulated);
         break;
     case sf::Generator::DelayVibLFO:
-        vibLFO_.setDelay(modulated);
+        control_.vibLFOs.setDelay(slot_, modulated);
         break;
     case sf::Generator::FreqVibLFO:
-        vibLFO_.setFrequency(modulated);
+        control_.vibLFOs.setFrequency(slot_, modulated);
         break;
     case sf::Generator::DelayModEnv:
-        modEnv_.setParameter(Envelope::Phase::Delay, modulated);
+        control_.modEnvs.setParameter(slot_, EnvelopeBank::Phase::Delay, modulated);
         break;
     case sf::Generator::AttackModEnv:
-        modEnv_.setParameter(Envelope::Phase::Attack, modulated);
+        control_.modEnvs.setParameter(slot_, EnvelopeBank::Phase::Attack, modulated);
         break;
     case sf::Generator::HoldModEnv:
     case sf::Generator::KeynumToModEnvHold:
-        modEnv_.setParameter(Envelope::Phase::Hold,
-                             getModulatedGenerator(sf::Generator::HoldModEnv) +
-                                 getModulatedGenerator(sf::Generator::KeynumToModEnvHold) * keyScaling_);
+        control_.modEnvs.setParameter(slot_, EnvelopeBank::Phase::Hold,
+                                      getModulatedGenerator(sf::Generator::HoldModEnv) +
+                                          getModulatedGenerator(sf::Generator::KeynumToModEnvHold) * keyScaling_);
         break;
     case sf::Generator::DecayModEnv:
     case sf::Generator::KeynumToModEnvDecay:
-        modEnv_.setParameter(Envelope::Phase::Decay,
-                             getModulatedGenerator(sf::Generator::DecayModEnv) +
-                                 getModulatedGenerator(sf::Generator::KeynumToModEnvDecay) * keyScaling_);
+        control_.modEnvs.setParameter(slot_, EnvelopeBank::Phase::Decay,
+                                      getModulatedGenerator(sf::Generator::DecayModEnv) +
+                                          getModulatedGenerator(sf::Generator::KeynumToModEnvDecay) * keyScaling_);
         break;
     case sf::Generator::SustainModEnv:
-        modEnv_.setParameter(Envelope::Phase::Sustain, modulated);
+        control_.modEnvs.setParameter(slot_, EnvelopeBank::Phase::Sustain, modulated);
         break;
     case sf::Generator::ReleaseModEnv:
-        modEnv_.setParameter(Envelope::Phase::Release, modulated);
+        control_.modEnvs.setParameter(slot_, EnvelopeBank::Phase::Release, modulated);
         break;
     case sf::Generator::DelayVolEnv:
-        volEnv_.setParameter(Envelope::Phase::Delay, modulated);
+        control_.volEnvs.setParameter(slot_, EnvelopeBank::Phase::Delay, modulated);
         break;
     case sf::Generator::AttackVolEnv:
-        volEnv_.setParameter(Envelope::Phase::Attack, modulated);
+        control_.volEnvs.setParameter(slot_, EnvelopeBank::Phase::Attack, modulated);
         break;
     case sf::Generator::HoldVolEnv:
     case sf::Generator::KeynumToVolEnvHold:
-        volEnv_.setParameter(Envelope::Phase::Hold,
-                             getModulatedGenerator(sf::Generator::HoldVolEnv) +
-                                 getModulatedGenerator(sf::Generator::KeynumToVolEnvHold) * keyScaling_);
+        control_.volEnvs.setParameter(slot_, EnvelopeBank::Phase::Hold,
+                                      getModulatedGenerator(sf::Generator::HoldVolEnv) +
+                                          getModulatedGenerator(sf::Generator::KeynumToVolEnvHold) * keyScaling_);
         break;
     case sf::Generator::DecayVolEnv:
     case sf::Generator::KeynumToVolEnvDecay:
-        volEnv_.setParameter(Envelope::Phase::Decay,
-                             getModulatedGenerator(sf::Generator::DecayVolEnv) +
-                                 getModulatedGenerator(sf::Generator::KeynumToVolEnvDecay) * keyScaling_);
+        control_.volEnvs.setParameter(slot_, EnvelopeBank::Phase::Decay,
+                                      getModulatedGenerator(sf::Generator::DecayVolEnv) +
+                                          getModulatedGenerator(sf::Generator::KeynumToVolEnvDecay) * keyScaling_);
         break;
     case sf::Generator::SustainVolEnv:
-        volEnv_.setParameter(Envelope::Phase::Sustain, modulated);
+        control_.volEnvs.setParameter(slot_, EnvelopeBank::Phase::Sustain, modulated);
         break;
     case sf::Generator::ReleaseVolEnv:
-        volEnv_.setParameter(Envelope::Phase::Release, modulated);
+        control_.volEnvs.setParameter(slot_, EnvelopeBank::Phase::Release, modulated);
         break;
     case sf::Generator::CoarseTune:
     case sf::Generator::FineTune:
@@ -332,6 +449,9 @@ void Voice::updateModulatedParams(sf::Generator destination) {
                       coarseTuning_ + getModulatedGenerator(sf::Generator::CoarseTune) +
                       0.01 * (fineTuning_ + getModulatedGenerator(sf::Generator::FineTune));
         break;
+    default:
+        // other generators are read from modulated_ when needed
+        break;
     }
 }
 }
@@ -0,0 +1,84 @@
+#include "wav_writer.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace primesynth {
+static constexpr std::uint16_t NUM_CHANNELS = 2;
+
+// WAV is little-endian
+template <typename T>
+void writeLE(std::ofstream& ofs, T value) {
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        ofs.put(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+WAVWriter::WAVWriter(const std::string& filename, double sampleRate, SampleFormat format)
+    : ofs_(filename, std::ios::binary),
+      sampleRate_(static_cast<std::uint32_t>(std::lround(sampleRate))),
+      format_(format),
+      numFrames_(0) {
+    if (!ofs_) {
+        throw std::runtime_error("failed to open file");
+    }
+    // sizes are filled in on close
+    writeHeader();
+}
+
+WAVWriter::~WAVWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void WAVWriter::write(const float* buffer, std::size_t numFrames) {
+    const std::size_t numSamples = NUM_CHANNELS * numFrames;
+    converted_.resize(numSamples * getBytesPerSample(format_));
+    convertSamples(buffer, numSamples, format_, converted_.data());
+    ofs_.write(converted_.data(), converted_.size());
+    if (!ofs_) {
+        throw std::runtime_error("failed to write WAV file");
+    }
+    numFrames_ += numFrames;
+}
+
+void WAVWriter::close() {
+    if (!ofs_.is_open()) {
+        return;
+    }
+    ofs_.seekp(0);
+    writeHeader();
+    ofs_.close();
+}
+
+void WAVWriter::writeHeader() {
+    const bool isFloat = format_ == SampleFormat::Float32;
+    const auto bytesPerSample = static_cast<std::uint16_t>(getBytesPerSample(format_));
+    const auto dataSize = static_cast<std::uint32_t>(numFrames_ * NUM_CHANNELS * bytesPerSample);
+    // non-PCM formats require fact chunk
+    const std::uint32_t factChunkSize = isFloat ? 12 : 0;
+
+    ofs_.write("RIFF", 4);
+    writeLE<std::uint32_t>(ofs_, 4 + 24 + factChunkSize + 8 + dataSize);
+    ofs_.write("WAVE", 4);
+
+    ofs_.write("fmt ", 4);
+    writeLE<std::uint32_t>(ofs_, 16);
+    writeLE<std::uint16_t>(ofs_, isFloat ? 3 /* WAVE_FORMAT_IEEE_FLOAT */ : 1 /* WAVE_FORMAT_PCM */);
+    writeLE<std::uint16_t>(ofs_, NUM_CHANNELS);
+    writeLE<std::uint32_t>(ofs_, sampleRate_);
+    writeLE<std::uint32_t>(ofs_, sampleRate_ * NUM_CHANNELS * bytesPerSample);
+    writeLE<std::uint16_t>(ofs_, NUM_CHANNELS * bytesPerSample);
+    writeLE<std::uint16_t>(ofs_, 8 * bytesPerSample);
+
+    if (isFloat) {
+        ofs_.write("fact", 4);
+        writeLE<std::uint32_t>(ofs_, 4);
+        writeLE<std::uint32_t>(ofs_, static_cast<std::uint32_t>(numFrames_));
+    }
+
+    ofs_.write("data", 4);
+    writeLE<std::uint32_t>(ofs_, dataSize);
+}
+}
@@ -0,0 +1,142 @@
+// renders random input through the interpolation kernels of every mode and compares the result with plain double
+// precision implementations of each mode, which follow the scalar rendering that Voice::render did per frame
+// SIMD kernels are chosen at compile time, so this is built once per instruction set
+#include "interpolation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace primesynth;
+
+// kernels use 24 bit fractions and single precision, while the reference is exact up to double precision
+static constexpr double TOLERANCE = 1e-6;
+// coefficient tables of kernels have this many phases between points, and the reference takes the same phases
+static constexpr double NUM_PHASES = 256.0;
+// tells CTest that the test was skipped
+static constexpr int SKIPPED = 77;
+
+// deterministic across platforms unlike std distributions
+class Random {
+public:
+    std::uint32_t next() {
+        state_ = state_ * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<std::uint32_t>(state_ >> 32);
+    }
+
+    float nextFloat() {
+        return static_cast<float>(next() >> 8) / (1 << 24);
+    }
+
+private:
+    std::uint64_t state_ = 1;
+};
+
+double interpolate(interp::Mode mode, const std::vector<std::int16_t>& samples, std::uint32_t index,
+                   std::uint32_t fraction) {
+    static constexpr double PI = 3.141592653589793;
+    const auto p = [&](std::int64_t offset) { return samples.at(static_cast<std::size_t>(index + offset)); };
+    const double r = fraction / 4294967296.0;
+    const double x = std::floor(r * NUM_PHASES) / NUM_PHASES;
+    switch (mode) {
+    case interp::Mode::None:
+        return r < 0.5 ? p(0) : p(1);
+    case interp::Mode::Linear:
+        return (1.0 - r) * p(0) + r * p(1);
+    case interp::Mode::Cubic:
+        return p(0) + 0.5 * x *
+                          (p(1) - p(-1) +
+                           x * (2.0 * p(-1) - 5.0 * p(0) + 4.0 * p(1) - p(2) + x * (3.0 * (p(0) - p(1)) + p(2) - p(-1))));
+    case interp::Mode::Sinc: {
+        // 8 points from index - 3 to index + 4, normalized so that DC gain is 1
+        double sum = 0.0, weights = 0.0;
+        for (std::int64_t j = -3; j <= 4; ++j) {
+            const double d = j - x;
+            const double sinc = d == 0.0 ? 1.0 : std::sin(PI * d) / (PI * d);
+            const double window = 0.42 + 0.5 * std::cos(PI * d / 4.0) + 0.08 * std::cos(PI * d / 2.0);
+            sum += sinc * window * p(j);
+            weights += sinc * window;
+        }
+        return sum / weights;
+    }
+    }
+    throw std::invalid_argument("unknown interpolation mode");
+}
+
+int main() {
+#if defined(__AVX2__) && !defined(PRIMESYNTH_NO_SIMD) && (defined(__GNUC__) || defined(__clang__))
+    if (!__builtin_cpu_supports("avx2")) {
+        std::cout << "AVX2 is not supported by this CPU" << std::endl;
+        return SKIPPED;
+    }
+#endif
+
+    static constexpr std::size_t NUM_SAMPLES = 1 << 12;
+    // every number of frames up to this is rendered, so that SIMD tails are covered
+    static constexpr std::size_t MAX_FRAMES = 67;
+
+    Random random;
+    // guard points are random too, as kernels must read them like any other points
+    std::vector<std::int16_t> samples(NUM_SAMPLES + 2 * interp::GUARD_POINTS);
+    for (auto& sample : samples) {
+        sample = static_cast<std::int16_t>(random.next() >> 16);
+    }
+
+    std::vector<std::uint32_t> indices(MAX_FRAMES), fractions(MAX_FRAMES);
+    std::vector<float> left(MAX_FRAMES), right(MAX_FRAMES);
+    bool passed = true;
+    static const std::pair<interp::Mode, const char*> MODES[] = {{interp::Mode::None, "none"},
+                                                                 {interp::Mode::Linear, "linear"},
+                                                                 {interp::Mode::Cubic, "cubic"},
+                                                                 {interp::Mode::Sinc, "sinc"}};
+    for (const auto& entry : MODES) {
+        const interp::Mode mode = entry.first;
+        double maxDiff = 0.0;
+        std::size_t numMismatches = 0;
+        for (std::size_t numFrames = 1; numFrames <= MAX_FRAMES; ++numFrames) {
+            // pitch from far below to about 3 octaves above sample rate, position in 32.32 fixed point
+            const std::uint64_t delta = random.next() * 8ull;
+            std::uint64_t position = (random.next() % 4ull) << 32 | random.next();
+            if (numFrames % 2 == 0) {
+                // end near the end of sample data instead of starting near the beginning, so that both are covered
+                position = ((NUM_SAMPLES - 1ull) << 32) - delta * (numFrames - 1) - position;
+            }
+            position += static_cast<std::uint64_t>(interp::GUARD_POINTS) << 32;
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                indices.at(i) = static_cast<std::uint32_t>(position >> 32);
+                fractions.at(i) = static_cast<std::uint32_t>(position);
+                position += delta;
+            }
+
+            const interp::Gain gain{random.nextFloat(), (random.nextFloat() - 0.5f) / numFrames, random.nextFloat(),
+                                    random.nextFloat()};
+            std::fill(left.begin(), left.end(), 0.5f);
+            std::fill(right.begin(), right.end(), -0.5f);
+            interp::render(mode, samples.data(), {indices.data(), fractions.data()}, numFrames, gain, left.data(),
+                           right.data());
+
+            for (std::size_t i = 0; i < numFrames; ++i) {
+                const double amp = gain.amp + static_cast<double>(i) * gain.deltaAmp;
+                const double sample = amp * interpolate(mode, samples, indices.at(i), fractions.at(i)) / INT16_MAX;
+                const double diffs[] = {std::abs(left.at(i) - (0.5 + gain.left * sample)),
+                                        std::abs(right.at(i) - (-0.5 + gain.right * sample))};
+                for (const double diff : diffs) {
+                    maxDiff = std::max(maxDiff, diff);
+                    // also catches NaN
+                    if (!(diff <= TOLERANCE)) {
+                        ++numMismatches;
+                    }
+                }
+            }
+        }
+
+        std::cout << entry.second << ": max difference " << maxDiff << ", " << numMismatches
+                  << " samples out of tolerance" << std::endl;
+        passed = passed && numMismatches == 0;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
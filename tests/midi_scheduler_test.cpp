@@ -0,0 +1,78 @@
+// simulates MIDI messages arriving while an audio device renders in its callback with a period longer than latency,
+// and checks that their relative timing is kept until the clocks are moved apart by an underrun
+#include "midi_scheduler.h"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace primesynth;
+
+static constexpr double SAMPLE_RATE = 44100.0;
+// 5 ms, the default latency, is 220 frames
+static constexpr double LATENCY = 0.005;
+static constexpr std::size_t PERIOD = 512;
+
+// audio device whose clock is advanced by hand, and which renders a period ahead of it like pull mode
+class Device {
+public:
+    explicit Device(Synthesizer& synth) : synth_(synth), buffer_(2 * PERIOD), frame_(0) {}
+
+    // calls back for every period started by time
+    void advanceTo(double time) {
+        while (frame_ <= time * SAMPLE_RATE) {
+            synth_.renderBlock(buffer_.data(), PERIOD);
+            frame_ += PERIOD;
+        }
+    }
+
+    // skips periods without advancing the clock, as audio output does after an underrun
+    void underrun(std::size_t numPeriods) {
+        for (std::size_t i = 0; i < numPeriods; ++i) {
+            synth_.renderBlock(buffer_.data(), PERIOD);
+        }
+    }
+
+private:
+    Synthesizer& synth_;
+    std::vector<float> buffer_;
+    double frame_;
+};
+
+int main() {
+    Synthesizer synth(SAMPLE_RATE, 1);
+    Device device(synth);
+    MIDIScheduler scheduler(synth, LATENCY);
+
+    // offset of scheduled frames from arrival times in frames, which changes only when re-anchored
+    const auto getOffset = [&](double time) {
+        device.advanceTo(time);
+        return static_cast<double>(scheduler.toFrame(time)) - time * SAMPLE_RATE;
+    };
+
+    bool passed = true;
+    // messages arrive at irregular intervals around a third of the period, so that they fall on every phase of it
+    double time = 1.0;
+    const double firstOffset = getOffset(time);
+    for (std::size_t i = 0; i < 1000; ++i) {
+        time += (100.0 + 37.0 * (i % 7)) / SAMPLE_RATE;
+        const double offset = getOffset(time);
+        // 1 frame of rounding of arrival times
+        if (offset < firstOffset - 1.0 || offset > firstOffset + 1.0) {
+            std::cout << "message " << i << " moved by " << offset - firstOffset << " frames" << std::endl;
+            passed = false;
+            break;
+        }
+    }
+
+    device.underrun(8);
+    time += 0.001;
+    const double offsetAfterUnderrun = getOffset(time);
+    if (offsetAfterUnderrun < firstOffset + 7 * PERIOD) {
+        std::cout << "not re-anchored after underrun" << std::endl;
+        passed = false;
+    }
+
+    std::cout << (passed ? "timing kept" : "timing lost") << std::endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}